@@ -0,0 +1,43 @@
+#! /usr/bin/env ruby
+
+# Measure how adding repositories via Pkg.RepositoryAdd scales with the number
+# of the added repositories. Every add checks the alias against the known
+# repositories, the time per repository should stay constant.
+#
+# Run it after installing the built package (see smoke_test_prepare.sh),
+# the repositories are only registered, nothing is written to the system.
+
+require "benchmark"
+require "yast"
+# import the pkg-bindings module
+Yast.import "Pkg"
+
+raise "Pkg.TargetInitialize failed!" unless Yast::Pkg.TargetInitialize("/")
+raise "Pkg.SourceRestore failed!" unless Yast::Pkg.SourceRestore
+
+puts "Known repositories: #{Yast::Pkg.SourceGetCurrent(false).size}"
+puts "repositories  total [s]  per repository [ms]"
+
+[10, 50, 100, 200, 500].each do |count|
+  ids = []
+
+  time = Benchmark.realtime do
+    count.times do |i|
+      # the same alias for all repositories, the unique alias is generated
+      id = Yast::Pkg.RepositoryAdd(
+        "alias"       => "benchmark",
+        "name"        => "Benchmark #{i}",
+        "base_urls"   => ["dir:///tmp/benchmark-#{i}"],
+        "enabled"     => false,
+        "autorefresh" => false
+      )
+      raise "Pkg.RepositoryAdd failed!" unless id
+      ids << id
+    end
+  end
+
+  printf("%12d  %9.3f  %19.3f\n", count, time, time * 1000 / count)
+
+  # the repositories are not saved, just unregister them
+  ids.each { |id| Yast::Pkg.SourceDelete(id) }
+end
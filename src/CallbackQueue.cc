@@ -0,0 +1,147 @@
+/*
+ * File:   CallbackQueue.cc
+ *
+ */
+
+#include "CallbackQueue.h"
+
+#include <chrono>
+
+#include <ycp/YCPBoolean.h>
+
+#define y2log_component "Pkg"
+#include <y2util/y2log.h>
+
+CallbackQueue::CallbackQueue()
+    : _owner(std::this_thread::get_id()), _finished(false), _closed(false), _abort(false)
+{
+}
+
+CallbackQueue::~CallbackQueue()
+{
+    close();
+}
+
+bool CallbackQueue::inOwnerThread() const
+{
+    return std::this_thread::get_id() == _owner;
+}
+
+void CallbackQueue::post(int id, Params &&params)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_closed)
+	return;
+
+    _events.push_back(new Event{id, std::move(params), false, false, YCPNull()});
+    _queued.notify_one();
+}
+
+YCPValue CallbackQueue::call(int id, Params &&params)
+{
+    // the event is owned by this (the worker) thread
+    Event event{id, std::move(params), true, false, YCPNull()};
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    if (_closed)
+	return YCPNull();
+
+    _events.push_back(&event);
+    _queued.notify_one();
+
+    _evaluated.wait(lock, [&event] { return event.done; });
+
+    return event.result;
+}
+
+void CallbackQueue::finish()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _finished = true;
+    _queued.notify_all();
+}
+
+int CallbackQueue::process(const Handler &handler, int timeout_ms)
+{
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now()
+	+ std::chrono::milliseconds(timeout_ms > 0 ? timeout_ms : 0);
+
+    int count = 0;
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _queued.wait_until(lock, deadline, [this] { return !_events.empty() || _finished || _closed; });
+
+    while (!_events.empty() && !_closed)
+    {
+	Event *event = _events.front();
+	_events.pop_front();
+	bool wait = event->wait;
+
+	// do not block the worker while evaluating the YCP code
+	lock.unlock();
+
+	if (wait)
+	{
+	    // the worker is blocked until "done" is set,
+	    // the parameters are released here, in the owner thread
+	    event->result = handler(event->id, event->params);
+	    event->params.clear();
+	}
+	else
+	{
+	    YCPValue result = handler(event->id, event->params);
+
+	    if (!result.isNull() && result->isBoolean() && !result->asBoolean()->value())
+	    {
+		y2milestone("Callback %d returned false, aborting", event->id);
+		_abort = true;
+	    }
+
+	    delete event;
+	}
+
+	lock.lock();
+
+	if (wait)
+	{
+	    event->done = true;
+	    _evaluated.notify_all();
+	}
+
+	++count;
+    }
+
+    return count;
+}
+
+bool CallbackQueue::finished() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _finished && _events.empty();
+}
+
+void CallbackQueue::close()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_closed)
+	return;
+
+    _closed = true;
+
+    for (Event *event : _events)
+    {
+	if (event->wait)
+	{
+	    event->result = YCPNull();
+	    event->done = true;
+	}
+	else
+	    delete event;
+    }
+
+    _events.clear();
+    _evaluated.notify_all();
+}
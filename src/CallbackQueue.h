@@ -0,0 +1,98 @@
+/*
+ * File:   CallbackQueue.h
+ *
+ * Passes the callbacks triggered in a worker thread (the asynchronous
+ * commit) to the thread which owns the YCP interpreter. The YCP code
+ * must not be evaluated in any other thread.
+ *
+ * The notifications (progress) are only queued, the worker continues
+ * immediately. The other callbacks (questions like media change or
+ * problem reports) block the worker until the owner thread evaluates
+ * them and passes back the result.
+ *
+ * The queue is drained by the owner in process() which is called with
+ * a timeout so a plain mutex with a condition variable is used.
+ */
+
+#ifndef CallbackQueue_h
+#define CallbackQueue_h
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <ycp/YCPValue.h>
+
+class CallbackQueue
+{
+  public:
+
+    typedef std::vector<YCPValue> Params;
+
+    // evaluate the callback in the owner thread, returns the callback result
+    typedef std::function<YCPValue(int, const Params &)> Handler;
+
+    // the current thread becomes the owner
+    CallbackQueue();
+
+    // the pending events are dropped, see close()
+    ~CallbackQueue();
+
+    bool inOwnerThread() const;
+
+    // worker: queue a notification, does not wait for the result
+    void post(int id, Params &&params);
+
+    // worker: queue a callback and wait for the result,
+    // returns YCPNull if the queue has been closed
+    YCPValue call(int id, Params &&params);
+
+    // worker: no more events will be sent
+    void finish();
+
+    // owner: wait at most timeout_ms for the events and evaluate them,
+    // returns the number of the evaluated events
+    int process(const Handler &handler, int timeout_ms);
+
+    // owner: the worker has finished and all events have been processed
+    bool finished() const;
+
+    // owner: stop processing the events, the pending and the future
+    // calls return immediately
+    void close();
+
+    // set when a notification returned false or by the owner
+    void requestAbort() { _abort = true; }
+    bool abortRequested() const { return _abort; }
+
+  private:
+
+    struct Event
+    {
+	int id;
+	Params params;
+	// the worker waits for the result (the event is owned by the worker)
+	bool wait;
+	bool done;
+	YCPValue result;
+    };
+
+    mutable std::mutex _mutex;
+    // signalled when an event is added or the worker finishes
+    std::condition_variable _queued;
+    // signalled when a call has been evaluated
+    std::condition_variable _evaluated;
+
+    std::deque<Event *> _events;
+
+    std::thread::id _owner;
+    bool _finished;
+    bool _closed;
+    std::atomic<bool> _abort;
+};
+
+#endif // CallbackQueue_h
@@ -135,12 +135,47 @@
       return stringutil::form( "CBid(%d)", id_r );
     }
 
+    // the default throttling of the progress callbacks: report the progress
+    // if the difference since the last report is at least 5% or after 3 seconds
+    PkgFunctions::CallbackHandler::YCPCallbacks::YCPCallbacks( )
+	: _throttle_step( 5 )
+	, _throttle_interval( 3 )
+	, _progress_enabled( true )
+	, _queue( NULL )
+    {}
+
+    PkgFunctions::CallbackHandler::YCPCallbacks::~YCPCallbacks( ) {
+       for (_cbcache_t::iterator it = _cbcache.begin(); it != _cbcache.end(); ++it)
+       {
+	   if (it->second.func && !it->second.in_use)
+	       delete it->second.func;
+       }
+    }
+
     void PkgFunctions::CallbackHandler::YCPCallbacks::popCallback( CBid id_r ) {
        _cbdata_t::iterator tmp1 = _cbdata.find(id_r);
        if (tmp1 != _cbdata.end() && !tmp1->second.empty())
        {
 	   y2debug("Unregistering callback, restoring the previous one");
            tmp1->second.pop();
+	   dropCached(id_r);
+       }
+    }
+
+    void PkgFunctions::CallbackHandler::YCPCallbacks::dropCached( CBid id_r ) {
+       _cbcache_t::iterator it = _cbcache.find(id_r);
+       if (it == _cbcache.end())
+	   return;
+
+       if (it->second.in_use)
+       {
+	   // the callback is being evaluated, delete it later
+	   it->second.stale = true;
+       }
+       else
+       {
+	   delete it->second.func;
+	   _cbcache.erase(it);
        }
     }
 
@@ -151,6 +186,7 @@
 	y2debug ("Registering callback %s", cbName(id_r).c_str());
 
         _cbdata[id_r].push(func_r);
+	dropCached(id_r);
     }
 
     /**
@@ -229,6 +265,143 @@
     }
 
 
+    Y2Function* PkgFunctions::CallbackHandler::YCPCallbacks::acquireCallback( CBid id_r ) const {
+	CachedCallback &cached = _cbcache[id_r];
+
+	// a nested evaluation of the same callback, use a new object
+	if (cached.in_use)
+	    return createCallback(id_r);
+
+	if (!cached.func)
+	    cached.func = createCallback(id_r);
+
+	if (cached.func)
+	    cached.in_use = true;
+
+	return cached.func;
+    }
+
+    void PkgFunctions::CallbackHandler::YCPCallbacks::releaseCallback( CBid id_r, Y2Function* func_r ) const {
+	_cbcache_t::iterator it = _cbcache.find(id_r);
+
+	if (it == _cbcache.end() || it->second.func != func_r)
+	{
+	    // not cached
+	    delete func_r;
+	    return;
+	}
+
+	if (it->second.stale)
+	{
+	    delete func_r;
+	    _cbcache.erase(it);
+	    return;
+	}
+
+	// remove the parameters which have not been evaluated
+	func_r->reset();
+	it->second.in_use = false;
+    }
+
+    bool PkgFunctions::CallbackHandler::YCPCallbacks::report( CBid id_r, int value_r, long long key_r ) const {
+	if (!_progress_enabled || !isSet(id_r))
+	    return false;
+
+	std::lock_guard<std::mutex> lock(_reportstate_mutex);
+	ReportState &state = _reportstate[id_r];
+	time_t now = time(NULL);
+
+	if (key_r != state.key || value_r - state.value >= _throttle_step || state.value - value_r >= _throttle_step
+	    || value_r == 100 || now - state.time >= _throttle_interval)
+	{
+	    if (state.suppressed > 0)
+		y2debug("%s: %u progress reports coalesced", cbName(id_r).c_str(), state.suppressed);
+
+	    state.value = value_r;
+	    state.time = now;
+	    state.key = key_r;
+	    state.suppressed = 0;
+	    state.pending = -1;
+
+	    return true;
+	}
+
+	++state.suppressed;
+	state.pending = value_r;
+	return false;
+    }
+
+    bool PkgFunctions::CallbackHandler::YCPCallbacks::finishReport( CBid id_r, int &value_r, long long key_r ) const {
+	std::lock_guard<std::mutex> lock(_reportstate_mutex);
+	_reportstate_t::iterator it = _reportstate.find(id_r);
+
+	if (it == _reportstate.end() || it->second.pending < 0 || it->second.key != key_r)
+	    return false;
+
+	ReportState &state = it->second;
+	value_r = state.pending;
+	y2debug("%s: reporting the last suppressed value %d", cbName(id_r).c_str(), value_r);
+
+	state.value = value_r;
+	state.time = time(NULL);
+	state.suppressed = 0;
+	state.pending = -1;
+
+	return true;
+    }
+
+    void PkgFunctions::CallbackHandler::YCPCallbacks::resetReport( CBid id_r ) const {
+	std::lock_guard<std::mutex> lock(_reportstate_mutex);
+	ReportState &state = _reportstate[id_r];
+	state = ReportState();
+	state.time = time(NULL);
+    }
+
+    void PkgFunctions::CallbackHandler::YCPCallbacks::setThrottle( int step_r, time_t interval_r, bool progress_r ) {
+	y2milestone("Callback throttling: step %d%%, interval %lds, progress %s", step_r, (long)interval_r,
+	    progress_r ? "enabled" : "disabled");
+
+	_throttle_step = step_r;
+	_throttle_interval = interval_r;
+	_progress_enabled = progress_r;
+    }
+
+    bool PkgFunctions::CallbackHandler::YCPCallbacks::isNotification( CBid id_r ) {
+	switch ( id_r ) {
+	  case CB_ProgressPackage:
+	  case CB_ProgressProvide:
+	  case CB_ProgressDownload:
+	  case CB_ProgressDeltaDownload:
+	  case CB_ProgressDeltaApply:
+	  case CB_ProgressProgress:
+	    return true;
+	  default:
+	    return false;
+	}
+    }
+
+    int PkgFunctions::CallbackHandler::YCPCallbacks::processQueue( int timeout_r ) {
+	if (!_queue)
+	    return 0;
+
+	return _queue->process( [this]( int id, const CallbackQueue::Params &params ) -> YCPValue {
+	    CBid id_r = static_cast<CBid>( id );
+	    Y2Function* func = acquireCallback( id_r );
+
+	    if (!func)
+		return YCPVoid();
+
+	    for (const YCPValue &param : params)
+		func->appendParameter( param );
+
+	    y2debug ("Evaluating queued callback %s", cbName( id_r ).c_str());
+	    YCPValue ret = func->evaluateCall();
+	    releaseCallback( id_r, func );
+
+	    return ret;
+	}, timeout_r );
+    }
+
 bool PkgFunctions::CallbackHandler::YCPCallbacks::Send::CB::expecting( YCPValueType exp_r ) const
 {
     if ( _result->valuetype() == exp_r )
@@ -239,12 +412,33 @@ bool PkgFunctions::CallbackHandler::YCPCallbacks::Send::CB::expecting( YCPValueT
 
 bool PkgFunctions::CallbackHandler::YCPCallbacks::Send::CB::evaluate()
 {
+    if ( _set && _marshal ) {
+      CallbackQueue* queue = _send.ycpcb().queue();
+
+      if ( isNotification( _id ) ) {
+	queue->post( _id, std::move( _params ) );
+	_params.clear();
+	_posted = true;
+	return false;
+      }
+
+      YCPValue result = queue->call( _id, std::move( _params ) );
+      _params.clear();
+
+      // the queue has been closed
+      if ( result.isNull() )
+	return false;
+
+      _result = result;
+      return true;
+    }
+
     if ( _set && _func ) {
       y2debug ("Evaluating callback (registered funciton: %s)", _func->name().c_str());
       _result = _func->evaluateCall ();
 
-      delete _func;
-      _func = _send.ycpcb().createCallback( _id );
+      // remove the parameters, the object can be evaluated again
+      _func->reset();
       return true;
     }
 
@@ -23,6 +23,8 @@
 #define PkgModuleCallbacksYCP_h
 
 #include <stack>
+#include <ctime>
+#include <mutex>
 
 #include <y2util/stringutil.h>
 //#include <y2util/Date.h>
@@ -33,6 +35,7 @@
 
 #include "ycpTools.h"
 #include "Callbacks.h"
+#include "CallbackQueue.h"
 
 //#include <ycp/y2log.h>
 
@@ -121,13 +124,65 @@ class PkgFunctions::CallbackHandler::YCPCallbacks
     typedef map <CBid, stack<YCPReference> > _cbdata_t;
     _cbdata_t _cbdata;
 
+    /**
+     * The function call object cached for a callback,
+     * see @ref acquireCallback.
+     **/
+    struct CachedCallback {
+      CachedCallback() : func( NULL ), in_use( false ), stale( false ) {}
+      Y2Function* func;
+      // currently being evaluated
+      bool in_use;
+      // the callback has been changed while in use, delete it when released
+      bool stale;
+    };
+
+    typedef map <CBid, CachedCallback> _cbcache_t;
+    mutable _cbcache_t _cbcache;
+
+    /**
+     * The last reported progress of a callback, see @ref report.
+     **/
+    struct ReportState {
+      ReportState() : value( 0 ), time( 0 ), key( 0 ), suppressed( 0 ), pending( -1 ) {}
+      int value;
+      time_t time;
+      long long key;
+      // number of the suppressed reports since the last report
+      unsigned suppressed;
+      // the last suppressed value (-1 = the last value has been reported)
+      int pending;
+    };
+
+    typedef map <CBid, ReportState> _reportstate_t;
+    mutable _reportstate_t _reportstate;
+    // the progress is also reported from the AsyncCommit() thread
+    mutable std::mutex _reportstate_mutex;
+
+    // the throttling policy, see @ref setThrottle
+    int _throttle_step;
+    time_t _throttle_interval;
+    bool _progress_enabled;
+
+    // the callbacks from the asynchronous commit, see @ref setQueue
+    CallbackQueue* _queue;
+
+    /**
+     * Remove the cached function call object, the callback has been changed.
+     **/
+    void dropCached( CBid id_r );
+
   public:
 
     /**
      * Constructor.
      **/
-    YCPCallbacks( )
-    {}
+    YCPCallbacks( );
+
+    /**
+     * Destructor.
+     **/
+    ~YCPCallbacks( );
 
 
     void popCallback( CBid id_r );
@@ -156,6 +211,84 @@ class PkgFunctions::CallbackHandler::YCPCallbacks
      **/
     Y2Function* createCallback( CBid id_r ) const;
 
+    /**
+     * @return The YCPCallback term, ready to append any arguments. Unlike
+     * @ref createCallback the object is cached and reused until the callback
+     * is changed, it must be returned by @ref releaseCallback.
+     **/
+    Y2Function* acquireCallback( CBid id_r ) const;
+
+    /**
+     * Return the object obtained by @ref acquireCallback.
+     **/
+    void releaseCallback( CBid id_r, Y2Function* func_r ) const;
+
+    /**
+     * Central throttling of the progress callbacks.
+     * @return Whether the progress value should be reported now. The value
+     * is reported if it differs by at least the configured step from the last
+     * reported value, if 100% is reached, if the configured interval has elapsed
+     * or if the key (e.g. a task ID) has been changed. The suppressed values
+     * are coalesced, the next reported value is always the current one.
+     * The last suppressed value is reported by @ref finishReport at the end.
+     * Returns false if the callback is not set.
+     **/
+    bool report( CBid id_r, int value_r, long long key_r = 0 ) const;
+
+    /**
+     * Start a new progress for the callback (reset the last reported value).
+     **/
+    void resetReport( CBid id_r ) const;
+
+    /**
+     * Finish the progress for the callback. Call it before sending the end
+     * of the progress so the UI always gets the final value.
+     * @param value_r the last value suppressed by @ref report
+     * @return true if the last value passed to @ref report (for the key)
+     * was suppressed and has to be reported now
+     **/
+    bool finishReport( CBid id_r, int &value_r, long long key_r = 0 ) const;
+
+    /**
+     * Set the throttling policy for @ref report.
+     * @param step_r min. difference in percent (0 = report all changes)
+     * @param interval_r report at least after this time (in seconds)
+     * @param progress_r false = do not report any throttled progress
+     **/
+    void setThrottle( int step_r, time_t interval_r, bool progress_r );
+
+    int throttleStep() const { return _throttle_step; }
+    time_t throttleInterval() const { return _throttle_interval; }
+    bool progressEnabled() const { return _progress_enabled; }
+
+  public:
+
+    /**
+     * Pass the callbacks triggered in other threads through the queue,
+     * NULL = evaluate them directly. The callbacks must not be changed
+     * while a queue is set.
+     **/
+    void setQueue( CallbackQueue* queue_r ) { _queue = queue_r; }
+    CallbackQueue* queue() const { return _queue; }
+
+    /**
+     * @return Whether the callback must be passed through the queue
+     * (called from a thread which cannot evaluate YCP code).
+     **/
+    bool marshalled() const { return _queue && !_queue->inOwnerThread(); }
+
+    /**
+     * @return Whether the callback is only a notification, the worker
+     * thread does not wait for the result.
+     **/
+    static bool isNotification( CBid id_r );
+
+    /**
+     * Evaluate the queued callbacks, wait at most timeout_r milliseconds.
+     * @return The number of evaluated callbacks.
+     **/
+    int processQueue( int timeout_r );
+
   public:
 
     /**
@@ -178,33 +311,47 @@ class PkgFunctions::CallbackHandler::YCPCallbacks
 	  const Send & _send;
 	  CBid _id;
 	  bool     _set;
+	  // called from a worker thread, the parameters are collected
+	  // in _params and the callback is passed through the queue
+	  bool     _marshal;
 	  Y2Function* _func;
 	  YCPValue _result;
+	  CallbackQueue::Params _params;
+	  // a queued notification, the result is not available
+	  bool     _posted;
 	  CB( const Send & send_r, CBid func )
 	    : _send( send_r )
 	    , _id( func )
 	    , _set( _send.ycpcb().isSet( func ) )
-	    , _func( _send.ycpcb().createCallback( func ) )
+	    , _marshal( _set && _send.ycpcb().marshalled() )
+	    , _func( _set && !_marshal ? _send.ycpcb().acquireCallback( func ) : NULL )
 	    , _result( YCPVoid() )
+	    , _posted( false )
 	  {}
 
 	  ~CB ()
 	  {
-	    if (_func) delete _func;
+	    if (_func) _send.ycpcb().releaseCallback( _id, _func );
+	  }
+
+	  CB & addValue( const YCPValue & arg ) {
+	    if (_func != NULL) _func->appendParameter( arg );
+	    else if (_marshal) _params.push_back( arg );
+	    return *this;
 	  }
 
-	  CB & addStr( const string & arg ) { if (_func != NULL) _func->appendParameter( YCPString( arg ) ); return *this; }
+	  CB & addStr( const string & arg ) { return _set ? addValue( YCPString( arg ) ) : *this; }
 	  CB & addStr( const zypp::Pathname & arg ) { return addStr( arg.asString() ); }
 	  CB & addStr( const zypp::Url & arg ) { return addStr( arg.asString() ); }
 
-	  CB & addInt( long long arg ) { if (_func != NULL) _func->appendParameter( YCPInteger( arg ) ); return *this; }
+	  CB & addInt( long long arg ) { return _set ? addValue( YCPInteger( arg ) ) : *this; }
 
-	  CB & addBool( bool arg ) { if (_func != NULL) _func->appendParameter( YCPBoolean( arg ) ); return *this; }
+	  CB & addBool( bool arg ) { return _set ? addValue( YCPBoolean( arg ) ) : *this; }
 
-	  CB & addMap( YCPMap arg ) { if (_func != NULL) _func->appendParameter( arg ); return *this; }
-	  CB & addList( YCPList arg ) { if (_func != NULL) _func->appendParameter( arg ); return *this; }
+	  CB & addMap( YCPMap arg ) { return addValue( arg ); }
+	  CB & addList( YCPList arg ) { return addValue( arg ); }
 
-	  CB & addSymbol( const string &arg ) { if (_func != NULL) _func->appendParameter( YCPSymbol(arg) ); return *this; }
+	  CB & addSymbol( const string &arg ) { return _set ? addValue( YCPSymbol(arg) ) : *this; }
 
 	  bool isStr() const { return _result->isString(); }
 	  bool isInt() const { return _result->isInteger(); }
@@ -230,8 +377,11 @@ class PkgFunctions::CallbackHandler::YCPCallbacks
 	    return evaluate( YT_INTEGER ) ? _result->asInteger()->value() : def_r;
 	  }
 
+	  // a queued notification continues unless an abort has been requested
 	  bool evaluateBool( const bool & def_r = false ) {
-	    return evaluate( YT_BOOLEAN ) ? _result->asBoolean()->value() : def_r;
+	    if (evaluate( YT_BOOLEAN ))
+	      return _result->asBoolean()->value();
+	    return _posted ? !_send.ycpcb().queue()->abortRequested() : def_r;
 	  }
 
 	  YCPMap evaluateMap( const YCPMap def_r = YCPMap())
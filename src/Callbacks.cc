@@ -57,10 +57,6 @@ typedef std::map<zypp::Url, MediaMap> RedirectMap;
 
 RedirectMap redirect_map;
 
-// default timeout for callbacks, evaluate the callbacks after 3 seconds
-// even if the progress percent has not been changed
-static const time_t callback_timeout = 3;
-
 ///////////////////////////////////////////////////////////////////
 namespace ZyppRecipients {
 ///////////////////////////////////////////////////////////////////
@@ -215,8 +211,6 @@ namespace ZyppRecipients {
     {
 	zypp::Resolvable::constPtr _last;
 	PkgFunctions &_pkg_ref;
-	int last_reported;
-	time_t last_reported_time;
 
 	InstallPkgReceive(RecipientCtl & construct_r, PkgFunctions &pk) : Recipient(construct_r), _last(NULL), _pkg_ref(pk)
 	{
@@ -233,8 +227,7 @@ namespace ZyppRecipients {
 	virtual void start(zypp::Resolvable::constPtr resolvable)
 	{
 	  // initialize the counter
-	  last_reported = 0;
-	  last_reported_time = time(NULL);
+	  ycpcb().resetReport( YCPCallbacks::CB_ProgressPackage );
 
 #warning install non-package
 	  zypp::Package::constPtr res =
@@ -245,7 +238,7 @@ namespace ZyppRecipients {
 	    return;
 
 	  // convert the repo ID
-	  PkgFunctions::RepoId source_id = _pkg_ref.logFindAlias(res->repoInfo().alias());
+	  PkgFunctions::RepoId source_id = _pkg_ref.logFindRepo(res->repository());
 	  int media_nr = res->mediaNr();
 
 	  if( source_id != _pkg_ref.LastReportedRepo() || media_nr != _pkg_ref.LastReportedMedium())
@@ -260,6 +253,9 @@ namespace ZyppRecipients {
 	    _pkg_ref.SetReportedSource(source_id, media_nr);
           }
 
+	  if (_pkg_ref.ActiveCommitPipeline())
+	    _pkg_ref.ActiveCommitPipeline()->installStart(res->satSolvable());
+
 	  CB callback( ycpcb( YCPCallbacks::CB_StartPackage ) );
 	  if (callback._set) {
 	    callback.addStr(res->name());
@@ -275,20 +271,20 @@ namespace ZyppRecipients {
 
 	virtual bool progress(int value, zypp::Resolvable::constPtr resolvable)
 	{
-	    CB callback( ycpcb( YCPCallbacks::CB_ProgressPackage) );
-	    // call the callback function only if the difference since the last call is at least 5%
-	    // or if 100% is reached or at least 3 seconds have elapsed
-	    time_t current_time = time(NULL);
-	    if (callback._set && (value - last_reported >= 5 || last_reported - value >= 5 || value == 100 || current_time - last_reported_time >= callback_timeout))
+	    // aborted while waiting for a package downloaded ahead
+	    if (_pkg_ref.ActiveCommitPipeline() && _pkg_ref.ActiveCommitPipeline()->aborted())
+		return false;
+
+	    // the throttling is done centrally, do not create the callback if not needed
+	    if (ycpcb().report( YCPCallbacks::CB_ProgressPackage, value ))
 	    {
+		CB callback( ycpcb( YCPCallbacks::CB_ProgressPackage) );
 		callback.addInt( value );
 		bool res = callback.evaluateBool();
 
 		if( !res )
 		    y2milestone( "Package installation callback returned abort" );
 
-		last_reported = value;
-		last_reported_time = current_time;
 		return res;
 	    }
 
@@ -337,6 +333,15 @@ namespace ZyppRecipients {
                 y2milestone("Error in finish callback: %s", reason.c_str());
             }
 
+            // the last progress value might have been throttled, report it before the end
+            int value;
+            if (ycpcb().finishReport( YCPCallbacks::CB_ProgressPackage, value ))
+            {
+                CB progress( ycpcb( YCPCallbacks::CB_ProgressPackage ) );
+                progress.addInt( value );
+                progress.evaluateBool(); // the package is already installed, abort is ignored
+            }
+
             CB callback( ycpcb( YCPCallbacks::CB_DonePackage) );
             if (callback._set) {
                 // report no error, errors were already reported in problem() callback above,
@@ -347,6 +352,10 @@ namespace ZyppRecipients {
                 // return value ignored
                 callback.evaluateStr();
             }
+
+	    // start downloading the next packages
+	    if (_pkg_ref.ActiveCommitPipeline())
+		_pkg_ref.ActiveCommitPipeline()->installDone(resolvable->satSolvable());
 	}
     };
 
@@ -463,11 +472,11 @@ namespace ZyppRecipients {
 
 	virtual bool progress(const zypp::ProgressData &task)
 	{
-	    CB callback( ycpcb( YCPCallbacks::CB_ProgressProgress ) );
 	    y2debug("ProgressProgress: id:%d, %s: %lld%%", task.numericId(), task.name().c_str(), task.reportValue());
 
-	    if (callback._set)
+	    if (ycpcb().report( YCPCallbacks::CB_ProgressProgress, task.reportValue(), task.numericId() ))
 	    {
+		CB callback( ycpcb( YCPCallbacks::CB_ProgressProgress ) );
 		callback.addInt( task.numericId() );
 		callback.addInt( task.val() );
 		callback.addInt( task.reportValue() );
@@ -479,6 +488,17 @@ namespace ZyppRecipients {
 
 	virtual void finish( const zypp::ProgressData &task )
 	{
+	    // the last progress value might have been throttled, report the final state
+	    int value;
+	    if (ycpcb().finishReport( YCPCallbacks::CB_ProgressProgress, value, task.numericId() ))
+	    {
+		CB progress( ycpcb( YCPCallbacks::CB_ProgressProgress ) );
+		progress.addInt( task.numericId() );
+		progress.addInt( task.val() );
+		progress.addInt( task.reportValue() );
+		progress.evaluateBool(); // the task is finished, abort is ignored
+	    }
+
 	    CB callback( ycpcb( YCPCallbacks::CB_ProgressDone ) );
 	    y2debug("ProgressFinish: id:%d, %s", task.numericId(), task.name().c_str());
 
@@ -500,17 +520,6 @@ namespace ZyppRecipients {
 	PkgFunctions &_pkg_ref;
 
 	DownloadResolvableReceive( RecipientCtl & construct_r, PkgFunctions &pk ) : Recipient( construct_r ), _pkg_ref(pk) {}
-	int last_reported;
-	time_t last_reported_time;
-
-	int last_reported_delta_download;
-	time_t last_reported_delta_download_time;
-
-	int last_reported_delta_apply;
-	time_t last_reported_delta_apply_time;
-
-	int last_reported_patch_download;
-	time_t last_reported_patch_download_time;
 
 	virtual void reportbegin()
 	{
@@ -523,8 +532,10 @@ namespace ZyppRecipients {
 	virtual void start( zypp::Resolvable::constPtr resolvable_ptr, const zypp::Url &url)
 	{
 	  unsigned size = 0;
-	  last_reported = 0;
-	  last_reported_time = time(NULL);
+	  ycpcb().resetReport( YCPCallbacks::CB_ProgressProvide );
+
+	  if (_pkg_ref.ActiveCommitPipeline())
+	    _pkg_ref.ActiveCommitPipeline()->downloadStart(resolvable_ptr->satSolvable());
 
 	  if ( zypp::isKind<zypp::Package> (resolvable_ptr) )
 	  {
@@ -534,7 +545,7 @@ namespace ZyppRecipients {
 	    size = pkg->downloadSize();
 
 	    // convert the repo ID
-	    PkgFunctions::RepoId source_id = _pkg_ref.logFindAlias(pkg->repoInfo().alias());
+	    PkgFunctions::RepoId source_id = _pkg_ref.logFindRepo(pkg->repository());
 	    int media_nr = pkg->mediaNr();
 
 	    if( source_id != _pkg_ref.LastReportedRepo() || media_nr != _pkg_ref.LastReportedMedium())
@@ -564,6 +575,18 @@ namespace ZyppRecipients {
 
 	virtual void finish(zypp::Resolvable::constPtr resolvable, zypp::repo::DownloadResolvableReport::Error error, const std::string &reason)
 	{
+	    if (_pkg_ref.ActiveCommitPipeline())
+		_pkg_ref.ActiveCommitPipeline()->downloadDone(resolvable->satSolvable());
+
+	    // the last progress value might have been throttled, report it before the end
+	    int value;
+	    if (ycpcb().finishReport( YCPCallbacks::CB_ProgressProvide, value ))
+	    {
+		CB progress( ycpcb( YCPCallbacks::CB_ProgressProvide ) );
+		progress.addInt( value );
+		progress.evaluateBool();
+	    }
+
 	    CB callback( ycpcb( YCPCallbacks::CB_DoneProvide) );
 	    if (callback._set) {
 		callback.addInt( error );
@@ -575,12 +598,13 @@ namespace ZyppRecipients {
 
         virtual bool progress(int value, zypp::Resolvable::constPtr resolvable_ptr)
         {
-	    CB callback( ycpcb( YCPCallbacks::CB_ProgressProvide) );
-	    time_t current_time = time(NULL);
-	    if (callback._set && (value - last_reported >= 5 || last_reported - value >= 5 || value == 100 || current_time - last_reported_time >= callback_timeout))
+	    // aborted while waiting for a package downloaded ahead
+	    if (_pkg_ref.ActiveCommitPipeline() && _pkg_ref.ActiveCommitPipeline()->aborted())
+		return false;
+
+	    if (ycpcb().report( YCPCallbacks::CB_ProgressProvide, value ))
 	    {
-		last_reported = value;
-		last_reported_time = current_time;
+		CB callback( ycpcb( YCPCallbacks::CB_ProgressProvide) );
 		callback.addInt( value );
 		return callback.evaluateBool(); // return value ignored by RpmDb
 	    }
@@ -621,8 +645,7 @@ namespace ZyppRecipients {
 	virtual void startDeltaDownload( const zypp::Pathname & filename, const zypp::ByteCount & downloadsize )
 	{
 	    // reset the counter
-	    last_reported_delta_download = 0;
-	    last_reported_delta_download_time = time(NULL);
+	    ycpcb().resetReport( YCPCallbacks::CB_ProgressDeltaDownload );
 
 	    CB callback( ycpcb( YCPCallbacks::CB_StartDeltaDownload) );
 	    if (callback._set) {
@@ -635,12 +658,9 @@ namespace ZyppRecipients {
 
 	virtual bool progressDeltaDownload( int value )
 	{
-	    CB callback( ycpcb( YCPCallbacks::CB_ProgressDeltaDownload) );
-	    time_t current_time = time(NULL);
-	    if (callback._set && (value - last_reported_delta_download >= 5 || last_reported_delta_download - value >= 5 || value == 100 || current_time - last_reported_delta_download_time >= callback_timeout))
+	    if (ycpcb().report( YCPCallbacks::CB_ProgressDeltaDownload, value ))
 	    {
-		last_reported_delta_download = value;
-		last_reported_delta_download_time = current_time;
+		CB callback( ycpcb( YCPCallbacks::CB_ProgressDeltaDownload) );
 		callback.addInt( value );
 
 		return callback.evaluateBool();
@@ -661,6 +681,14 @@ namespace ZyppRecipients {
 
 	virtual void finishDeltaDownload()
 	{
+	    int value;
+	    if (ycpcb().finishReport( YCPCallbacks::CB_ProgressDeltaDownload, value ))
+	    {
+		CB progress( ycpcb( YCPCallbacks::CB_ProgressDeltaDownload ) );
+		progress.addInt( value );
+		progress.evaluateBool();
+	    }
+
 	    CB callback( ycpcb( YCPCallbacks::CB_FinishDeltaDownload ) );
 
 	    if (callback._set)
@@ -677,8 +705,7 @@ namespace ZyppRecipients {
 	virtual void startDeltaApply( const zypp::Pathname & filename )
 	{
 	    // reset the counter
-	    last_reported_delta_apply = 0;
-	    last_reported_delta_apply_time = time(NULL);
+	    ycpcb().resetReport( YCPCallbacks::CB_ProgressDeltaApply );
 
 	    CB callback( ycpcb( YCPCallbacks::CB_StartDeltaApply) );
 	    if (callback._set) {
@@ -690,12 +717,9 @@ namespace ZyppRecipients {
 
 	virtual void progressDeltaApply( int value )
 	{
-	    CB callback( ycpcb( YCPCallbacks::CB_ProgressDeltaApply ) );
-	    time_t current_time = time(NULL);
-	    if (callback._set && (value - last_reported_delta_apply >= 5 || last_reported_delta_apply - value >= 5 || value == 100 || current_time - last_reported_delta_apply_time >= callback_timeout))
+	    if (ycpcb().report( YCPCallbacks::CB_ProgressDeltaApply, value ))
 	    {
-		last_reported_delta_apply = value;
-		last_reported_delta_apply_time = current_time;
+		CB callback( ycpcb( YCPCallbacks::CB_ProgressDeltaApply ) );
 		callback.addInt( value );
 
 		callback.evaluate();
@@ -715,6 +739,14 @@ namespace ZyppRecipients {
 
 	virtual void finishDeltaApply()
 	{
+	    int value;
+	    if (ycpcb().finishReport( YCPCallbacks::CB_ProgressDeltaApply, value ))
+	    {
+		CB progress( ycpcb( YCPCallbacks::CB_ProgressDeltaApply ) );
+		progress.addInt( value );
+		progress.evaluate();
+	    }
+
 	    CB callback( ycpcb( YCPCallbacks::CB_FinishDeltaApply ) );
 
 	    if (callback._set)
@@ -788,15 +820,16 @@ namespace ZyppRecipients {
     ///////////////////////////////////////////////////////////////////
     struct DownloadProgressReceive : public Recipient, public zypp::callback::ReceiveReport<zypp::media::DownloadProgressReport>
     {
-	int last_reported;
-	time_t last_reported_time;
+	// the last transfer rates, reported with the final throttled value
+	double _bps_avg;
+	double _bps_current;
 
-	DownloadProgressReceive( RecipientCtl & construct_r ) : Recipient( construct_r ) {}
+	DownloadProgressReceive( RecipientCtl & construct_r ) : Recipient( construct_r ), _bps_avg( 0 ), _bps_current( 0 ) {}
 
         virtual void start( const zypp::Url &file, zypp::Pathname localfile )
 	{
-	    last_reported = 0;
-	    last_reported_time = time(NULL);
+	    ycpcb().resetReport( YCPCallbacks::CB_ProgressDownload );
+	    _bps_avg = _bps_current = 0;
 	    CB callback( ycpcb( YCPCallbacks::CB_StartDownload ) );
 
 	    if ( callback._set )
@@ -809,14 +842,14 @@ namespace ZyppRecipients {
 
         virtual bool progress(int value, const zypp::Url &file, double bps_avg, double bps_current)
         {
-	    CB callback( ycpcb( YCPCallbacks::CB_ProgressDownload ) );
 	    // call the callback function only if the difference since the last call is at least 5%
-	    // or if 100% is reached or if at least 3 seconds have elapsed
-	    time_t current_time = time(NULL);
-	    if (callback._set && (value - last_reported >= 5 || last_reported - value >= 5 || value == 100 || current_time - last_reported_time >= callback_timeout))
+	    // or if 100% is reached or if at least 3 seconds have elapsed (see YCPCallbacks::report())
+	    _bps_avg = bps_avg;
+	    _bps_current = bps_current;
+
+	    if (ycpcb().report( YCPCallbacks::CB_ProgressDownload, value ))
 	    {
-		last_reported = value;
-		last_reported_time = current_time;
+		CB callback( ycpcb( YCPCallbacks::CB_ProgressDownload ) );
 		// report changed values
 		callback.addInt( value );
 		callback.addInt( (long long) bps_avg  );
@@ -855,6 +888,17 @@ namespace ZyppRecipients {
 
         virtual void finish( const zypp::Url &file, zypp::media::DownloadProgressReport::Error error, const std::string &reason)
 	{
+	    // the last progress value might have been throttled, report it before the end
+	    int value;
+	    if (ycpcb().finishReport( YCPCallbacks::CB_ProgressDownload, value ))
+	    {
+		CB progress( ycpcb( YCPCallbacks::CB_ProgressDownload ) );
+		progress.addInt( value );
+		progress.addInt( (long long) _bps_avg );
+		progress.addInt( (long long) _bps_current );
+		progress.evaluateBool( true );
+	    }
+
 	    CB callback( ycpcb( YCPCallbacks::CB_DoneDownload ) );
 
 	    zypp::media::DownloadProgressReport::Error err = error;
@@ -1536,6 +1580,16 @@ class PkgFunctions::CallbackHandler::ZyppReceive : public ZyppRecipients::Recipi
       , _keyRingReceive( *this, pkg )
       , _keyRingSignal( *this )
       , _authReceive( *this )
+    {
+	connect();
+    }
+
+    virtual ~ZyppReceive()
+    {
+	disconnect();
+    }
+
+    void connect()
     {
 	// connect the receivers
 	_rebuildDbReceive.connect();
@@ -1555,7 +1609,7 @@ class PkgFunctions::CallbackHandler::ZyppReceive : public ZyppRecipients::Recipi
 	_authReceive.connect();
     }
 
-    virtual ~ZyppReceive()
+    void disconnect()
     {
 	// disconnect the receivers
 	_rebuildDbReceive.disconnect();
@@ -1609,3 +1663,15 @@ PkgFunctions::CallbackHandler::~CallbackHandler()
   delete &_ycpCallbacks;
 }
 
+///////////////////////////////////////////////////////////////////
+//
+//
+//	METHOD NAME : PkgFunctions::CallbackHandler::disconnectReceivers
+//	METHOD TYPE : void
+//
+void PkgFunctions::CallbackHandler::disconnectReceivers()
+{
+  y2debug("Disconnecting the libzypp callback receivers");
+  _zyppReceive.disconnect();
+}
+
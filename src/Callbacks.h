@@ -93,6 +93,12 @@ class PkgFunctions::CallbackHandler {
      * Destructor. Reset Y2PMCallbacks to it's defaults.
      **/
     ~CallbackHandler();
+
+    /**
+     * Reset Y2PMCallbacks to it's defaults, used in a forked worker
+     * process which must not evaluate any YCP callback.
+     **/
+    void disconnectReceivers();
 };
 
 namespace ZyppRecipients {
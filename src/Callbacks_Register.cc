@@ -30,6 +30,10 @@
 #include "Callbacks.YCP.h" // PkgFunctions::CallbackHandler::YCPCallbacks
 #include "log.h"
 #include <ycp/y2log.h>
+#include <ycp/YCPBoolean.h>
+#include <ycp/YCPInteger.h>
+#include <ycp/YCPString.h>
+#include <ycp/YCPMap.h>
 
 
 ///////////////////////////////////////////////////////////////////
@@ -787,5 +791,55 @@ YCPValue PkgFunctions::CallbackFileConflictFinish( const YCPValue& args )
     return SET_YCP_CB( CB_FileConflictFinish, args);
 }
 
+/**
+ * @builtin CallbackThrottle
+ * @short Configure the throttling of the progress callbacks
+ * @description
+ * The package, download, delta rpm and general progress callbacks are evaluated
+ * only if the progress has changed enough or after some time. The suppressed
+ * progress values are not lost, the next evaluated callback gets the current value.
+ *
+ * @param map config the keys which are not present are not changed:
+ *   "step" (integer) min. progress difference in percent (default 5, 0 = report all changes),
+ *   "interval" (integer) evaluate the callback at least after this time in seconds (default 3),
+ *   "progress" (boolean) false = do not evaluate these progress callbacks at all
+ *   (e.g. in an unattended installation without any UI), default true
+ * @return boolean true on success, false on invalid values
+ */
+YCPValue PkgFunctions::CallbackThrottle( const YCPMap& config )
+{
+    if (config.isNull())
+    {
+	y2error("CallbackThrottle: nil argument");
+	return YCPBoolean(false);
+    }
+
+    CallbackHandler::YCPCallbacks &ycpcb = _callbackHandler._ycpCallbacks;
+
+    long long step = ycpcb.throttleStep();
+    long long interval = ycpcb.throttleInterval();
+    bool progress = ycpcb.progressEnabled();
+
+    YCPValue step_value = config->value(YCPString("step"));
+    if (!step_value.isNull() && step_value->isInteger())
+	step = step_value->asInteger()->value();
+
+    YCPValue interval_value = config->value(YCPString("interval"));
+    if (!interval_value.isNull() && interval_value->isInteger())
+	interval = interval_value->asInteger()->value();
+
+    YCPValue progress_value = config->value(YCPString("progress"));
+    if (!progress_value.isNull() && progress_value->isBoolean())
+	progress = progress_value->asBoolean()->value();
+
+    if (step < 0 || step > 100 || interval < 0)
+    {
+	y2error("CallbackThrottle: invalid values: %s", config->toString().c_str());
+	return YCPBoolean(false);
+    }
+
+    ycpcb.setThrottle(step, interval, progress);
+    return YCPBoolean(true);
+}
 
 #undef SET_YCP_CB
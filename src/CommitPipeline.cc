@@ -0,0 +1,420 @@
+/*
+ * File:   CommitPipeline.cc
+ *
+ */
+
+#include "CommitPipeline.h"
+
+#include <chrono>
+#include <limits>
+
+#include <unistd.h>
+
+#include <ycp/YCPBoolean.h>
+#include <ycp/YCPInteger.h>
+#include <ycp/YCPString.h>
+#include <ycp/YCPSymbol.h>
+
+#include <zypp/Package.h>
+#include <zypp/PathInfo.h>
+#include <zypp/ProgressData.h>
+#include <zypp/base/String.h>
+#include <zypp/sat/Transaction.h>
+#include <zypp/repo/PackageProvider.h>
+
+#define y2log_component "Pkg"
+#include <y2util/y2log.h>
+
+#include "i18n.h"
+
+const size_t CommitPipeline::NONE = std::numeric_limits<size_t>::max();
+
+namespace
+{
+    long long now_ms()
+    {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+	    std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+CommitPipeline::CommitPipeline(const Settings &settings, const std::function<void()> &child_init)
+    : _settings(settings), _procs(child_init), _current(NONE), _next(0), _window_bytes(0),
+    _aborted(false)
+{
+}
+
+CommitPipeline::~CommitPipeline()
+{
+    // the commit has been aborted or has failed, stop the remaining downloads
+    _procs.killAll();
+
+    for (size_t idx : _workers)
+	close(_items[idx].fd);
+
+    int prefetched = 0;
+
+    for (const Item &item : _items)
+    {
+	if (!item.prefetched)
+	    continue;
+
+	++prefetched;
+
+	// remove the unused packages from the cache, the commit
+	// removes the installed ones
+	if (!item.installed && !item.solvable.repoInfo().keepPackages())
+	{
+	    zypp::Package::constPtr pkg = zypp::make<zypp::Package>(item.solvable);
+	    zypp::Pathname cached(pkg->cachedLocation());
+
+	    if (!cached.empty())
+	    {
+		y2milestone("Removing unused package %s", cached.c_str());
+		zypp::filesystem::unlink(cached);
+	    }
+	}
+    }
+
+    y2milestone("Commit pipeline: %d of %zd packages downloaded ahead", prefetched, _items.size());
+}
+
+void CommitPipeline::start()
+{
+    zypp::sat::Transaction trans(zypp::sat::Transaction::loadFromPool);
+    trans.order();
+
+    for (zypp::sat::Transaction::const_iterator step = trans.begin(); step != trans.end(); ++step)
+    {
+	if (step->stepType() != zypp::sat::Transaction::TRANSACTION_INSTALL
+	    && step->stepType() != zypp::sat::Transaction::TRANSACTION_MULTIINSTALL)
+	    continue;
+
+	zypp::sat::Solvable solvable(step->satSolvable());
+
+	if (!solvable.isKind<zypp::Package>())
+	    continue;
+
+	zypp::Package::constPtr pkg = zypp::make<zypp::Package>(solvable);
+
+	Item item;
+	item.solvable = solvable;
+	item.size = pkg->downloadSize();
+	// downloading from a local medium ahead does not help
+	item.fetch = solvable.repoInfo().url().schemeIsDownloading() && pkg->cachedLocation().empty();
+
+	_index[solvable.id()] = _items.size();
+	_items.push_back(item);
+    }
+
+    y2milestone("Commit pipeline: %zd packages, window: %d packages, %lld bytes, %d connections",
+	_items.size(), _settings.packages, _settings.bytes, _settings.connections);
+
+    fill();
+
+    // the commit must not start downloading the first package itself
+    if (!_items.empty() && _items[0].pid > 0)
+	reap(0);
+}
+
+size_t CommitPipeline::find(const zypp::sat::Solvable &solvable) const
+{
+    std::map<zypp::sat::detail::SolvableIdType, size_t>::const_iterator it = _index.find(solvable.id());
+    return it == _index.end() ? NONE : it->second;
+}
+
+void CommitPipeline::installStart(const zypp::sat::Solvable &solvable)
+{
+    size_t idx = find(solvable);
+
+    if (idx == NONE)
+	return;
+
+    // the download has not finished yet (the commit order differs)
+    if (_items[idx].pid > 0)
+	reap(idx);
+
+    // the previous packages downloaded ahead have not been installed
+    // (e.g. a problem has been ignored), do not count them anymore
+    for (size_t prev = (_current == NONE ? 0 : _current); prev < idx; ++prev)
+    {
+	Item &item = _items[prev];
+
+	if (item.in_window && item.pid < 0)
+	{
+	    y2milestone("Package %s has not been installed", item.solvable.asString().c_str());
+	    leaveWindow(item);
+	}
+    }
+
+    _current = idx;
+    if (_next <= idx)
+	_next = idx + 1;
+
+    _items[idx].started = now_ms();
+
+    fill();
+}
+
+void CommitPipeline::installDone(const zypp::sat::Solvable &solvable)
+{
+    size_t idx = find(solvable);
+
+    if (idx == NONE)
+	return;
+
+    Item &item = _items[idx];
+
+    if (!item.installed)
+    {
+	item.install_ms = now_ms() - item.started;
+	item.installed = true;
+	leaveWindow(item);
+    }
+
+    // the commit continues with the next package, it must be complete in the cache
+    if (idx + 1 < _items.size() && _items[idx + 1].pid > 0)
+	reap(idx + 1);
+
+    fill();
+}
+
+void CommitPipeline::downloadStart(const zypp::sat::Solvable &solvable)
+{
+    size_t idx = find(solvable);
+
+    if (idx == NONE)
+	return;
+
+    // the commit must not download the package in parallel with the worker,
+    // wait for it, the commit then finds the package in the cache
+    if (_items[idx].pid > 0)
+    {
+	y2milestone("Package %s is still being downloaded ahead, waiting", solvable.asString().c_str());
+	reap(idx);
+    }
+
+    _items[idx].started = now_ms();
+}
+
+void CommitPipeline::downloadDone(const zypp::sat::Solvable &solvable)
+{
+    size_t idx = find(solvable);
+
+    if (idx == NONE)
+	return;
+
+    _items[idx].download_ms = now_ms() - _items[idx].started;
+}
+
+void CommitPipeline::fill()
+{
+    reap();
+
+    if (_current != NONE && _next <= _current)
+	_next = _current + 1;
+
+    while (!_aborted && _workers.size() < (size_t)_settings.connections && _next < _items.size())
+    {
+	// the package count window, counted from the package being installed
+	if (_current == NONE ? _next >= (size_t)_settings.packages : _next > _current + _settings.packages)
+	    break;
+
+	Item &item = _items[_next];
+
+	if (!item.fetch || item.installed)
+	{
+	    ++_next;
+	    continue;
+	}
+
+	// the size window, the next package is downloaded always
+	if (_settings.bytes > 0 && _window_bytes > 0 && _window_bytes + item.size > _settings.bytes)
+	    break;
+
+	int fd = -1;
+	pid_t pid = startWorker(item, fd);
+
+	if (pid < 0)
+	{
+	    y2error("Cannot start a download worker, the commit will download the packages");
+	    _next = _items.size();
+	    break;
+	}
+
+	y2debug("Downloading %s ahead (pid %d)", item.solvable.asString().c_str(), pid);
+
+	item.pid = pid;
+	item.fd = fd;
+	item.in_window = true;
+	_window_bytes += item.size;
+	_workers.push_back(_next);
+	++_next;
+    }
+}
+
+void CommitPipeline::reap(size_t wait_for)
+{
+    ForkedWorkers::Finished done = [this](pid_t pid, int status) { finished(pid, status); };
+
+    _procs.collect(done);
+
+    if (wait_for == NONE || _items[wait_for].pid < 0)
+	return;
+
+    const Item &item = _items[wait_for];
+
+    // keep the UI alive while waiting, the progress callback can abort the commit
+    zypp::callback::SendReport<zypp::ProgressReport> report;
+    zypp::ProgressData progress;
+    progress.name(zypp::str::form(_("Downloading package %s"), item.solvable.name().c_str()));
+    progress.sendTo(zypp::ProgressReportAdaptor(zypp::ProgressData::ReceiverFnc(), report));
+
+    if (!_procs.wait(item.pid, [&] { return progress.tick(); }, done))
+	abort();
+}
+
+void CommitPipeline::abort()
+{
+    y2milestone("Commit aborted while waiting for a package downloaded ahead");
+    _aborted = true;
+
+    _procs.killAll();
+
+    for (size_t idx : _workers)
+    {
+	Item &item = _items[idx];
+	close(item.fd);
+	item.fd = -1;
+	item.pid = -1;
+	leaveWindow(item);
+    }
+
+    _workers.clear();
+}
+
+void CommitPipeline::leaveWindow(Item &item)
+{
+    if (!item.in_window)
+	return;
+
+    item.in_window = false;
+    _window_bytes -= item.size;
+}
+
+void CommitPipeline::finished(pid_t pid, int status)
+{
+    std::vector<size_t>::iterator it = _workers.begin();
+    while (it != _workers.end() && _items[*it].pid != pid)
+	++it;
+
+    if (it == _workers.end())
+	return;
+
+    Item &item = _items[*it];
+    _workers.erase(it);
+
+    // the download time measured by the worker
+    long long elapsed = -1;
+    if (read(item.fd, &elapsed, sizeof(elapsed)) != sizeof(elapsed))
+	elapsed = -1;
+
+    close(item.fd);
+    item.fd = -1;
+    item.pid = -1;
+
+    if (ForkedWorkers::exited(status, 0))
+    {
+	item.prefetched = true;
+	item.download_ms = elapsed;
+    }
+    else
+    {
+	y2warning("Downloading %s ahead failed, the commit will download it", item.solvable.asString().c_str());
+	leaveWindow(item);
+    }
+}
+
+pid_t CommitPipeline::startWorker(const Item &item, int &fd)
+{
+    int fds[2];
+
+    if (pipe(fds) < 0)
+	return -1;
+
+    pid_t pid = _procs.start([&] {
+	close(fds[0]);
+	return download(item, fds[1]);
+    });
+
+    close(fds[1]);
+
+    if (pid < 0)
+	close(fds[0]);
+    else
+	fd = fds[0];
+
+    return pid;
+}
+
+int CommitPipeline::download(const Item &item, int fd)
+{
+    long long start = now_ms();
+    int ret = 1;
+
+    try
+    {
+	zypp::Package::constPtr pkg = zypp::make<zypp::Package>(item.solvable);
+
+	zypp::repo::RepoMediaAccess access;
+	zypp::repo::PackageProviderPolicy policy;
+	zypp::repo::DeltaCandidates deltas;
+	zypp::repo::PackageProvider provider(access, pkg, deltas, policy);
+
+	zypp::ManagedFile file(provider.providePackage());
+	// keep the package in the cache, the commit takes it from there
+	file.resetDispose();
+
+	ret = 0;
+    }
+    catch (const zypp::Exception& excpt)
+    {
+	y2error("Downloading %s ahead failed: %s", item.solvable.asString().c_str(), excpt.asString().c_str());
+    }
+
+    long long elapsed = now_ms() - start;
+    if (write(fd, &elapsed, sizeof(elapsed)) != sizeof(elapsed))
+	ret = 1;
+
+    return ret;
+}
+
+void CommitPipeline::addSettings(YCPMap &map) const
+{
+    map->add(YCPString("download_mode"), YCPSymbol("download_pipeline"));
+    map->add(YCPString("prefetch_packages"), YCPInteger(_settings.packages));
+    map->add(YCPString("prefetch_bytes"), YCPInteger(_settings.bytes));
+    map->add(YCPString("connections"), YCPInteger(_settings.connections));
+}
+
+YCPList CommitPipeline::timing() const
+{
+    YCPList ret;
+
+    for (const Item &item : _items)
+    {
+	if (!item.installed && item.download_ms < 0)
+	    continue;
+
+	YCPMap m;
+	m->add(YCPString("name"), YCPString(item.solvable.name()));
+	m->add(YCPString("version"), YCPString(item.solvable.edition().asString()));
+	m->add(YCPString("arch"), YCPString(item.solvable.arch().asString()));
+	m->add(YCPString("download_time"), YCPInteger(item.download_ms));
+	m->add(YCPString("install_time"), YCPInteger(item.install_ms));
+	m->add(YCPString("prefetched"), YCPBoolean(item.prefetched));
+	ret->add(m);
+    }
+
+    return ret;
+}
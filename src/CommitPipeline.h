@@ -0,0 +1,152 @@
+/*
+ * File:   CommitPipeline.h
+ *
+ * The download-ahead commit mode (`download_pipeline). The commit itself
+ * downloads and installs the packages one by one (DownloadAsNeeded), the
+ * pipeline downloads the next packages to the package cache in worker
+ * processes while the current package is being installed so the commit
+ * finds them there.
+ *
+ * libzypp is not thread safe, the workers are forked processes (see
+ * ForkedWorkers, like the parallel repository refresh). The order of
+ * the packages is taken from the ordered pool transaction which is
+ * the order used by the commit.
+ */
+
+#ifndef CommitPipeline_h
+#define CommitPipeline_h
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// pid_t
+#include <sys/types.h>
+
+#include <ycp/YCPList.h>
+#include <ycp/YCPMap.h>
+
+#include <zypp/sat/Solvable.h>
+
+#include "ForkedWorkers.h"
+
+class CommitPipeline
+{
+  public:
+
+    struct Settings
+    {
+	Settings() : enabled(false), packages(4), bytes(0), connections(2) {}
+
+	// the `download_pipeline mode is used
+	bool enabled;
+	// max. number of packages downloaded ahead
+	int packages;
+	// max. total size of the packages downloaded ahead (0 = unlimited)
+	long long bytes;
+	// max. number of parallel downloads
+	int connections;
+    };
+
+    // child_init is called in the forked worker process (disconnect the callbacks)
+    CommitPipeline(const Settings &settings, const std::function<void()> &child_init);
+
+    // stops the running workers, removes the unused downloaded packages
+    ~CommitPipeline();
+
+    const Settings &settings() const { return _settings; }
+
+    // start downloading the first packages (before the commit)
+    void start();
+
+    // the commit installs a package
+    void installStart(const zypp::sat::Solvable &solvable);
+    void installDone(const zypp::sat::Solvable &solvable);
+
+    // the commit downloads a package itself (not downloaded ahead)
+    void downloadStart(const zypp::sat::Solvable &solvable);
+    void downloadDone(const zypp::sat::Solvable &solvable);
+
+    // the user aborted the commit while waiting for a download,
+    // the commit callbacks should abort the commit
+    bool aborted() const { return _aborted; }
+
+    // add the settings to the map (see Pkg::CommitPolicy())
+    void addSettings(YCPMap &map) const;
+
+    // the download and install time of each package
+    YCPList timing() const;
+
+  private:
+
+    struct Item
+    {
+	Item() : size(0), fetch(false), pid(-1), fd(-1), prefetched(false), in_window(false), started(0),
+	    download_ms(-1), install_ms(-1), installed(false) {}
+
+	zypp::sat::Solvable solvable;
+	long long size;
+	// can be downloaded ahead (a remote repository, not in the cache yet)
+	bool fetch;
+
+	// the running worker
+	pid_t pid;
+	// pipe for reading the download time measured by the worker
+	int fd;
+	bool prefetched;
+	// counted in the size window (downloaded ahead, not installed yet)
+	bool in_window;
+
+	// start time of the running download or installation (in ms)
+	long long started;
+	long long download_ms;
+	long long install_ms;
+	bool installed;
+    };
+
+    // start the workers for the packages in the window
+    void fill();
+
+    // collect the finished workers, wait for the specified item
+    // (the progress is ticked while waiting, the user can abort the commit)
+    void reap(size_t wait_for = NONE);
+    void finished(pid_t pid, int status);
+
+    // stop all downloads after the user abort
+    void abort();
+
+    // remove the package from the size window
+    void leaveWindow(Item &item);
+
+    pid_t startWorker(const Item &item, int &fd);
+    // the download job run in the worker process
+    int download(const Item &item, int fd);
+
+    // the index of the package, NONE if not found
+    size_t find(const zypp::sat::Solvable &solvable) const;
+
+    Settings _settings;
+    ForkedWorkers _procs;
+
+    // the packages in the commit order
+    std::vector<Item> _items;
+    std::map<zypp::sat::detail::SolvableIdType, size_t> _index;
+
+    static const size_t NONE;
+
+    // the package being installed (NONE before the first one),
+    // the next package to download
+    size_t _current;
+    size_t _next;
+
+    // the items with a running worker
+    std::vector<size_t> _workers;
+
+    // size of the downloaded not yet installed packages
+    long long _window_bytes;
+
+    bool _aborted;
+};
+
+#endif // CommitPipeline_h
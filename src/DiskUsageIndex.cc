@@ -0,0 +1,150 @@
+/*
+ * File:   DiskUsageIndex.cc
+ *
+ */
+
+#include "DiskUsageIndex.h"
+
+#include <zypp/PoolItem.h>
+#include <zypp/ResPool.h>
+#include <zypp/base/Easy.h>
+
+#define y2log_component "Pkg"
+#include <y2util/y2log.h>
+
+DiskUsageIndex::DiskUsageIndex()
+    : _valid(false)
+{
+}
+
+void DiskUsageIndex::reset()
+{
+    _valid = false;
+    _partitions.clear();
+    _usage.clear();
+    _selected.clear();
+    _installed.clear();
+    _removed.clear();
+}
+
+void DiskUsageIndex::update(const MountPointSet &partitions)
+{
+    if (_valid && !_pool.changed())
+	return;
+
+    if (_valid)
+	y2milestone("The pool has been changed, dropping the disk usage index");
+
+    reset();
+
+    _partitions = partitions;
+    _counter.setMountPoints(partitions);
+    _installed.assign(partitions.size(), 0LL);
+    _removed.assign(partitions.size(), 0LL);
+
+    _pool.update();
+    _valid = true;
+}
+
+const DiskUsageIndex::Usage &DiskUsageIndex::usage(zypp::sat::detail::SolvableIdType id)
+{
+    std::unordered_map<zypp::sat::detail::SolvableIdType, Usage>::const_iterator it = _usage.find(id);
+
+    if (it != _usage.end())
+	return it->second;
+
+    MountPointSet mps = _counter.disk_usage(zypp::sat::Solvable(id));
+
+    Usage u;
+    u.reserve(mps.size());
+
+    for_(mp, mps.begin(), mps.end())
+    {
+	u.push_back(mp->pkg_size - mp->used_size);
+    }
+
+    return _usage.emplace(id, u).first->second;
+}
+
+void DiskUsageIndex::account(zypp::sat::detail::SolvableIdType id, bool remove, int sign)
+{
+    const Usage &u = usage(id);
+    Usage &totals = remove ? _removed : _installed;
+
+    for (Usage::size_type i = 0; i < u.size() && i < totals.size(); ++i)
+	totals[i] += sign * u[i];
+}
+
+DiskUsageIndex::MountPointSet DiskUsageIndex::result(const Usage &installed, const Usage &removed) const
+{
+    MountPointSet ret;
+    Usage::size_type i = 0;
+
+    for_(it, _partitions.begin(), _partitions.end())
+    {
+	zypp::DiskUsageCounter::MountPoint mp(*it);
+	mp.pkg_size = mp.used_size + installed[i];
+
+	// the removed files still take the space on a grow only file system
+	if (!mp.growonly)
+	    mp.pkg_size -= removed[i];
+
+	ret.insert(mp);
+	++i;
+    }
+
+    return ret;
+}
+
+DiskUsageIndex::MountPointSet DiskUsageIndex::solvable(const zypp::sat::Solvable &solvable, const MountPointSet &partitions)
+{
+    update(partitions);
+
+    return result(usage(solvable.id()), Usage(_partitions.size(), 0LL));
+}
+
+DiskUsageIndex::MountPointSet DiskUsageIndex::selection(const MountPointSet &partitions)
+{
+    update(partitions);
+
+    // remove the solvables which do not transact anymore
+    std::unordered_map<zypp::sat::detail::SolvableIdType, bool>::iterator sel = _selected.begin();
+
+    while (sel != _selected.end())
+    {
+	zypp::PoolItem item(zypp::sat::Solvable(sel->first));
+
+	if (item && item.status().transacts())
+	{
+	    ++sel;
+	    continue;
+	}
+
+	account(sel->first, sel->second, -1);
+	sel = _selected.erase(sel);
+    }
+
+    // add the new ones
+    int added = 0;
+    zypp::ResPool pool(zypp::ResPool::instance());
+
+    for_(it, pool.begin(), pool.end())
+    {
+	if (!it->status().transacts())
+	    continue;
+
+	zypp::sat::detail::SolvableIdType id = it->satSolvable().id();
+
+	if (_selected.find(id) != _selected.end())
+	    continue;
+
+	bool remove = it->status().isInstalled();
+	account(id, remove, 1);
+	_selected.emplace(id, remove);
+	++added;
+    }
+
+    y2debug("Disk usage: %d new selected items, %zd selected, %zd indexed", added, _selected.size(), _usage.size());
+
+    return result(_installed, _removed);
+}
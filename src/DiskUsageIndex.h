@@ -0,0 +1,77 @@
+/*
+ * File:   DiskUsageIndex.h
+ *
+ * The disk usage of the single solvables computed once per mount point
+ * set (see Pkg::TargetInitDU()) and the running totals of the current
+ * selection.
+ *
+ * The disk usage of a solvable is evaluated by libzypp when it is needed
+ * for the first time, the selection totals are updated only for the
+ * solvables which started or stopped transacting since the last call so
+ * the whole selection is not evaluated again.
+ *
+ * The index is dropped when the mount points or the pool content change
+ * (the solvable IDs are not valid anymore).
+ */
+
+#ifndef DiskUsageIndex_h
+#define DiskUsageIndex_h
+
+#include <unordered_map>
+#include <vector>
+
+#include <zypp/DiskUsageCounter.h>
+#include <zypp/sat/Solvable.h>
+
+#include "PoolState.h"
+
+class DiskUsageIndex
+{
+  public:
+
+    typedef zypp::DiskUsageCounter::MountPointSet MountPointSet;
+
+    DiskUsageIndex();
+
+    // the mount points have been changed
+    void reset();
+
+    // disk usage of a single solvable (see DiskUsageCounter::disk_usage(sat::Solvable))
+    MountPointSet solvable(const zypp::sat::Solvable &solvable, const MountPointSet &partitions);
+
+    // disk usage after committing the current selection
+    // (see DiskUsageCounter::disk_usage(ResPool))
+    MountPointSet selection(const MountPointSet &partitions);
+
+  private:
+
+    // the size change for each mount point (in the _partitions order)
+    typedef std::vector<long long> Usage;
+
+    // drop the index if the pool has been changed
+    void update(const MountPointSet &partitions);
+
+    const Usage &usage(zypp::sat::detail::SolvableIdType id);
+
+    // add (sign = 1) or remove (sign = -1) the solvable from the totals
+    void account(zypp::sat::detail::SolvableIdType id, bool remove, int sign);
+
+    MountPointSet result(const Usage &installed, const Usage &removed) const;
+
+    bool _valid;
+    PoolSerial _pool;
+
+    MountPointSet _partitions;
+    zypp::DiskUsageCounter _counter;
+
+    std::unordered_map<zypp::sat::detail::SolvableIdType, Usage> _usage;
+
+    // the solvables counted in the totals, true = installed (to be removed)
+    std::unordered_map<zypp::sat::detail::SolvableIdType, bool> _selected;
+
+    // the totals of the packages to install and to remove
+    Usage _installed;
+    Usage _removed;
+};
+
+#endif // DiskUsageIndex_h
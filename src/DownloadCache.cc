@@ -0,0 +1,251 @@
+/*
+ * File:   DownloadCache.cc
+ *
+ */
+
+#include "DownloadCache.h"
+
+#include <sstream>
+
+#include <zypp/PathInfo.h>
+
+#define y2log_component "Pkg"
+#include <y2util/y2log.h>
+
+// 100MiB
+const zypp::ByteCount::SizeType DownloadCache::default_limit = 100 * 1024 * 1024;
+
+namespace
+{
+    // the size of a file or a directory (recursively)
+    zypp::ByteCount disk_size(const zypp::Pathname &path)
+    {
+	zypp::PathInfo info(path);
+
+	if (!info.isDir())
+	    return info.isFile() ? zypp::ByteCount(info.size()) : zypp::ByteCount(0);
+
+	zypp::ByteCount ret;
+	std::list<zypp::filesystem::DirEntry> entries;
+
+	if (zypp::filesystem::readdir(entries, path, false) != 0)
+	    return ret;
+
+	for (std::list<zypp::filesystem::DirEntry>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+	    ret += disk_size(path / it->name);
+
+	return ret;
+    }
+}
+
+DownloadCache::DownloadCache() : _limit(default_limit), _auto_release(false)
+{
+}
+
+std::string DownloadCache::key(const std::string &alias, unsigned int medium,
+    const std::string &path, const std::string &mode)
+{
+    std::ostringstream str;
+    str << alias << '\n' << medium << '\n' << mode << '\n' << path;
+    return str.str();
+}
+
+zypp::Pathname DownloadCache::find(const std::string &key)
+{
+    std::unordered_map<std::string, std::list<Entry>::iterator>::iterator it = _index.find(key);
+
+    if (it == _index.end())
+	return zypp::Pathname();
+
+    // the file has been removed meanwhile
+    if (!zypp::PathInfo(it->second->path).isExist())
+    {
+	y2warning("Cached file %s is missing", it->second->path.asString().c_str());
+	remove(it->second);
+	return zypp::Pathname();
+    }
+
+    // move to the front
+    _entries.splice(_entries.begin(), _entries, it->second);
+    it->second->pinned = true;
+
+    y2milestone("Using cached file %s", it->second->path.asString().c_str());
+    return it->second->path;
+}
+
+void DownloadCache::add(const std::string &key, const std::string &alias, const zypp::filesystem::TmpDir &dir,
+    const zypp::Pathname &path)
+{
+    std::unordered_map<std::string, std::list<Entry>::iterator>::iterator it = _index.find(key);
+
+    // replace the old entry, keep it if the path has been returned
+    if (it != _index.end())
+    {
+	if (it->second->pinned)
+	{
+	    it->second->stale = true;
+	    _index.erase(it);
+	}
+	else
+	    remove(it->second);
+    }
+
+    // several files downloaded to the same directory share the record
+    std::shared_ptr<Dir> cached_dir(findDir(dir.path()));
+
+    if (!cached_dir)
+    {
+	// (do not default construct the TmpDir, it would create a new directory)
+	cached_dir.reset(new Dir{dir, disk_size(dir.path())});
+	_size += cached_dir->size;
+    }
+
+    _entries.push_front(Entry{key, alias, cached_dir, path, true, false});
+    _index[key] = _entries.begin();
+
+    y2debug("Cached %s (directory %s), total: %s", path.asString().c_str(), cached_dir->size.asString().c_str(),
+	_size.asString().c_str());
+
+    evict();
+}
+
+bool DownloadCache::unpin(const zypp::Pathname &path)
+{
+    bool found = false;
+
+    for (std::list<Entry>::iterator it = _entries.begin(); it != _entries.end();)
+    {
+	if (it->path != path)
+	{
+	    ++it;
+	    continue;
+	}
+
+	found = true;
+	it = unpin(it);
+    }
+
+    evict();
+
+    return found;
+}
+
+void DownloadCache::startRequest()
+{
+    if (!_auto_release)
+	return;
+
+    for (std::list<Entry>::iterator it = _entries.begin(); it != _entries.end();)
+    {
+	if (it->pinned)
+	    it = unpin(it);
+	else
+	    ++it;
+    }
+
+    evict();
+}
+
+std::list<DownloadCache::Entry>::iterator DownloadCache::unpin(std::list<Entry>::iterator it)
+{
+    // not usable anymore, remove it now
+    if (it->stale)
+    {
+	remove(it++);
+	return it;
+    }
+
+    it->pinned = false;
+    return ++it;
+}
+
+void DownloadCache::invalidate(const std::string &alias)
+{
+    int count = 0;
+
+    for (std::list<Entry>::iterator it = _entries.begin(); it != _entries.end();)
+    {
+	if (it->alias != alias || it->stale)
+	{
+	    ++it;
+	    continue;
+	}
+
+	++count;
+	_index.erase(it->key);
+
+	if (it->pinned)
+	{
+	    // the path has been returned, keep the file until it is released
+	    it->stale = true;
+	    ++it;
+	}
+	else
+	    remove(it++);
+    }
+
+    if (count > 0)
+	y2milestone("Repository %s has been changed, dropped %d cached files", alias.c_str(), count);
+}
+
+void DownloadCache::setLimit(zypp::ByteCount limit)
+{
+    y2milestone("Download cache limit: %s, releasing the returned paths at the next request",
+	limit.asString().c_str());
+    _limit = limit;
+    _auto_release = true;
+    evict();
+}
+
+size_t DownloadCache::release()
+{
+    size_t ret = _entries.size();
+
+    y2milestone("Releasing %zd cached downloads (%s)", ret, _size.asString().c_str());
+
+    _index.clear();
+    _entries.clear();
+    _size = 0;
+
+    return ret;
+}
+
+void DownloadCache::evict()
+{
+    std::list<Entry>::iterator it = _entries.end();
+
+    while (_size > _limit && it != _entries.begin())
+    {
+	--it;
+
+	// the caller still uses the path
+	if (it->pinned)
+	    continue;
+
+	y2milestone("Removing cached file %s", it->path.asString().c_str());
+	remove(it++);
+    }
+}
+
+void DownloadCache::remove(std::list<Entry>::iterator it)
+{
+    // the directory is removed when the last entry using it is removed
+    if (it->dir.use_count() == 1)
+	_size -= it->dir->size;
+
+    if (!it->stale)
+	_index.erase(it->key);
+
+    _entries.erase(it);
+}
+
+std::shared_ptr<DownloadCache::Dir> DownloadCache::findDir(const zypp::Pathname &path) const
+{
+    for (std::list<Entry>::const_iterator it = _entries.begin(); it != _entries.end(); ++it)
+    {
+	if (it->dir->dir.path() == path)
+	    return it->dir;
+    }
+
+    return std::shared_ptr<Dir>();
+}
@@ -0,0 +1,119 @@
+/*
+ * File:   DownloadCache.h
+ *
+ * The files downloaded by the SourceProvide*() calls which need
+ * a temporary directory (the signed or digested files and directories).
+ *
+ * The entries are identified by the repository, the medium, the path and
+ * the check mode so a repeated request for the same file does not download
+ * it again. The total size of the temporary directories is limited, the least
+ * recently used entries are removed when the limit is exceeded.
+ *
+ * The paths returned to the caller must stay valid until they are released
+ * (see unpin() and release()), the pinned entries are never removed by the
+ * limit. When the limit is set explicitly the caller opts in to the automatic
+ * release, the paths are valid only until the next request (see startRequest()).
+ * The entries of a repository are dropped when its URL or metadata change,
+ * the pinned ones are kept on disk until they are released.
+ */
+
+#ifndef DownloadCache_h
+#define DownloadCache_h
+
+#include <string>
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+#include <zypp/ByteCount.h>
+#include <zypp/Pathname.h>
+#include <zypp/TmpPath.h>
+
+class DownloadCache
+{
+  public:
+
+    // the default size limit
+    static const zypp::ByteCount::SizeType default_limit;
+
+    DownloadCache();
+
+    // create the cache key
+    static std::string key(const std::string &alias, unsigned int medium,
+	const std::string &path, const std::string &mode);
+
+    // the local path of a cached file or directory, an empty path if not found,
+    // the found entry is pinned
+    zypp::Pathname find(const std::string &key);
+
+    // add a downloaded (pinned) file or directory, the directory is kept
+    // as long as any entry refers to it
+    void add(const std::string &key, const std::string &alias, const zypp::filesystem::TmpDir &dir,
+	const zypp::Pathname &path);
+
+    // the caller does not use the path anymore, the file is kept for reuse
+    // until it is removed by the limit, returns false if the path is not known
+    bool unpin(const zypp::Pathname &path);
+
+    // a new download request, releases the paths returned by the previous
+    // requests if the limit has been set explicitly (see setLimit())
+    void startRequest();
+
+    // the repository has been changed, do not use the cached files anymore
+    void invalidate(const std::string &alias);
+
+    // set the limit, enables the automatic release of the returned paths
+    void setLimit(zypp::ByteCount limit);
+    zypp::ByteCount limit() const { return _limit; }
+    zypp::ByteCount size() const { return _size; }
+    size_t count() const { return _entries.size(); }
+
+    // remove all entries (and the downloaded files), returns the number of removed entries
+    size_t release();
+
+  private:
+
+    // a temporary directory shared by the entries downloaded together
+    struct Dir
+    {
+	// keep a reference so the directory is not deleted
+	zypp::filesystem::TmpDir dir;
+	// the size of the whole directory (including the index and signature files)
+	zypp::ByteCount size;
+    };
+
+    struct Entry
+    {
+	std::string key;
+	std::string alias;
+	std::shared_ptr<Dir> dir;
+	zypp::Pathname path;
+	// the path has been returned to the caller
+	bool pinned;
+	// not used for the new requests (invalidated), kept until unpinned
+	bool stale;
+    };
+
+    // remove the least recently used not pinned entries over the limit
+    void evict();
+
+    void remove(std::list<Entry>::iterator it);
+
+    // unpin the entry, remove it if it is stale; returns the next entry
+    std::list<Entry>::iterator unpin(std::list<Entry>::iterator it);
+
+    // find the directory record of an already cached directory
+    std::shared_ptr<Dir> findDir(const zypp::Pathname &path) const;
+
+    // the most recently used entry is the first one
+    std::list<Entry> _entries;
+    std::unordered_map<std::string, std::list<Entry>::iterator> _index;
+
+    zypp::ByteCount _limit;
+    zypp::ByteCount _size;
+
+    // release the returned paths at the next request
+    bool _auto_release;
+};
+
+#endif // DownloadCache_h
@@ -0,0 +1,148 @@
+/*
+ * File:   ForkedWorkers.cc
+ *
+ */
+
+#include "ForkedWorkers.h"
+
+#include <algorithm>
+
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define y2log_component "Pkg"
+#include <y2util/y2log.h>
+
+namespace
+{
+    // the polling interval (in microseconds)
+    const useconds_t POLL_INTERVAL = 100000;
+}
+
+ForkedWorkers::ForkedWorkers(const std::function<void()> &child_init)
+    : _child_init(child_init)
+{
+}
+
+ForkedWorkers::~ForkedWorkers()
+{
+    killAll();
+}
+
+pid_t ForkedWorkers::start(const std::function<int()> &job)
+{
+    pid_t pid = fork();
+
+    // the parent process or an error
+    if (pid != 0)
+    {
+	if (pid > 0)
+	    _pids.push_back(pid);
+
+	return pid;
+    }
+
+    // the worker process, the UI belongs to the parent,
+    // do not evaluate any YCP callback here
+    _child_init();
+
+    int ret = 1;
+
+    try
+    {
+	ret = job();
+    }
+    catch (...)
+    {
+	y2error("Unhandled exception in the worker process");
+    }
+
+    // do not run the destructors or the atexit handlers, they would release
+    // the resources owned by the parent process (temporary directories, media, locks...)
+    _exit(ret);
+}
+
+size_t ForkedWorkers::collect(const Finished &finished)
+{
+    size_t count = 0;
+    std::vector<pid_t>::iterator it = _pids.begin();
+
+    while (it != _pids.end())
+    {
+	pid_t pid = *it;
+	int status = 0;
+	pid_t ret = waitpid(pid, &status, WNOHANG);
+
+	// still running
+	if (ret == 0)
+	{
+	    ++it;
+	    continue;
+	}
+
+	if (ret < 0)
+	    y2error("waitpid(%d) failed", pid);
+
+	it = _pids.erase(it);
+	++count;
+
+	finished(pid, ret < 0 ? -1 : status);
+    }
+
+    return count;
+}
+
+bool ForkedWorkers::pause(const Tick &tick)
+{
+    // keep the UI alive, the progress callback can abort the work
+    if (!tick())
+	return false;
+
+    usleep(POLL_INTERVAL);
+    return true;
+}
+
+bool ForkedWorkers::wait(pid_t pid, const Tick &tick, const Finished &finished)
+{
+    std::vector<pid_t>::iterator it = std::find(_pids.begin(), _pids.end(), pid);
+
+    if (it == _pids.end())
+	return true;
+
+    while (true)
+    {
+	int status = 0;
+	pid_t ret = waitpid(pid, &status, WNOHANG);
+
+	if (ret != 0)
+	{
+	    if (ret < 0)
+		y2error("waitpid(%d) failed", pid);
+
+	    _pids.erase(it);
+	    finished(pid, ret < 0 ? -1 : status);
+
+	    return true;
+	}
+
+	if (!pause(tick))
+	    return false;
+    }
+}
+
+void ForkedWorkers::killAll()
+{
+    for (pid_t pid : _pids)
+    {
+	kill(pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+    }
+
+    _pids.clear();
+}
+
+bool ForkedWorkers::exited(int status, int code)
+{
+    return status >= 0 && WIFEXITED(status) && WEXITSTATUS(status) == code;
+}
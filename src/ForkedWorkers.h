@@ -0,0 +1,67 @@
+/*
+ * File:   ForkedWorkers.h
+ *
+ * The worker processes used for the parallel work (the parallel repository
+ * and service refresh, the download-ahead commit pipeline). libzypp is not
+ * thread safe, the work is done in forked processes which report only
+ * the exit code back.
+ *
+ * The workers must not evaluate any YCP callback, the UI belongs to
+ * the parent process. The parent polls the workers and keeps the UI alive
+ * by a progress tick which can abort the work.
+ */
+
+#ifndef ForkedWorkers_h
+#define ForkedWorkers_h
+
+#include <functional>
+#include <vector>
+
+// pid_t
+#include <sys/types.h>
+
+class ForkedWorkers
+{
+  public:
+
+    // a finished worker, status is the waitpid() status or -1 if waitpid failed
+    typedef std::function<void(pid_t pid, int status)> Finished;
+    // keeps the UI alive while waiting, false = abort
+    typedef std::function<bool()> Tick;
+
+    // child_init is called in the worker process (disconnect the callbacks)
+    ForkedWorkers(const std::function<void()> &child_init);
+
+    // kills the remaining workers
+    ~ForkedWorkers();
+
+    // run the job in a new worker process, the result of the job is
+    // the exit code of the worker; returns the PID or -1 (errno is set)
+    pid_t start(const std::function<int()> &job);
+
+    size_t running() const { return _pids.size(); }
+
+    // collect the finished workers (does not block),
+    // returns the number of the collected workers
+    size_t collect(const Finished &finished);
+
+    // sleep a bit before the next collect(), false if aborted by the tick
+    bool pause(const Tick &tick);
+
+    // wait for the worker, the other finished workers are collected later;
+    // false if aborted by the tick (the worker is still running)
+    bool wait(pid_t pid, const Tick &tick, const Finished &finished);
+
+    // terminate all running workers
+    void killAll();
+
+    // the worker exited normally with the code
+    static bool exited(int status, int code);
+
+  private:
+
+    std::function<void()> _child_init;
+    std::vector<pid_t> _pids;
+};
+
+#endif // ForkedWorkers_h
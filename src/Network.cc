@@ -29,28 +29,132 @@
 #include <PkgFunctions.h>
 #include "log.h"
 
-// system()
-#include <cstdlib>
+// getifaddrs()
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+
+#include <ycp/YCPBoolean.h>
+#include <ycp/YCPMap.h>
+#include <ycp/YCPString.h>
 
 #include <zypp/Url.h>
 
+// how long (in seconds) the detected network status is valid
+#define NETWORK_STATUS_TTL 5
+
 /*
   Textdomain "pkg-bindings"
 */
 
 /*
   A helper function
-  Detect whether there is a network connection.
+  Detect the configured network addresses. The loopback and the IPv6
+  link-local addresses are ignored, they cannot be used for accessing
+  the remote repositories.
   See isNetworkRunning() function in NetworkService.ycp
 */
-bool PkgFunctions::NetworkDetected()
+const PkgFunctions::NetworkState &PkgFunctions::DetectNetwork(bool force)
 {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+    if (!force && network_state.valid &&
+	now - network_state.checked < std::chrono::seconds(NETWORK_STATUS_TTL))
+    {
+	y2debug("Using the cached network status");
+	return network_state;
+    }
+
     y2milestone("Checking the network status...");
-    // check IPv4 network
-    int result = ::system("ip addr|grep -v '127.0.0\\|inet6'|grep -q inet &> /dev/null");
-    y2milestone("Network is running: %s", (result == 0) ? "yes" : "no");
 
-    return !result;
+    NetworkState state;
+    struct ifaddrs *addrs = NULL;
+
+    if (getifaddrs(&addrs) != 0)
+    {
+	y2error("Cannot read the network interfaces: %s", strerror(errno));
+    }
+    else
+    {
+	for (struct ifaddrs *ifa = addrs; ifa != NULL; ifa = ifa->ifa_next)
+	{
+	    if (ifa->ifa_addr == NULL || !(ifa->ifa_flags & IFF_UP) || (ifa->ifa_flags & IFF_LOOPBACK))
+		continue;
+
+	    if (ifa->ifa_addr->sa_family == AF_INET)
+	    {
+		const struct sockaddr_in *addr = reinterpret_cast<const struct sockaddr_in *>(ifa->ifa_addr);
+
+		// 127.0.0.0/8
+		if ((ntohl(addr->sin_addr.s_addr) >> 24) != 127)
+		{
+		    y2debug("IPv4 address found at %s", ifa->ifa_name);
+		    state.ipv4 = true;
+		}
+	    }
+	    else if (ifa->ifa_addr->sa_family == AF_INET6)
+	    {
+		const struct sockaddr_in6 *addr = reinterpret_cast<const struct sockaddr_in6 *>(ifa->ifa_addr);
+
+		if (!IN6_IS_ADDR_LOOPBACK(&addr->sin6_addr) && !IN6_IS_ADDR_LINKLOCAL(&addr->sin6_addr))
+		{
+		    y2debug("IPv6 address found at %s", ifa->ifa_name);
+		    state.ipv6 = true;
+		}
+	    }
+	}
+
+	freeifaddrs(addrs);
+    }
+
+    state.valid = true;
+    state.checked = now;
+    network_state = state;
+
+    y2milestone("Network status: IPv4: %s, IPv6: %s", state.ipv4 ? "yes" : "no", state.ipv6 ? "yes" : "no");
+
+    return network_state;
+}
+
+/*
+  A helper function
+  Detect whether there is a network connection.
+*/
+bool PkgFunctions::NetworkDetected()
+{
+    const NetworkState &state = DetectNetwork();
+    bool running = state.ipv4 || state.ipv6;
+
+    y2milestone("Network is running: %s", running ? "yes" : "no");
+
+    return running;
+}
+
+/**
+   @builtin NetworkStatus
+   @short Return the detected network status
+   @description
+   The status is cached for a few seconds, it is shared with the network
+   check done in SourceLoad() and in the other calls accessing the repositories.
+
+   @param boolean refresh check the network interfaces again, do not use the cached status
+   @return map $[ "running" : boolean, "ipv4" : boolean, "ipv6" : boolean ],
+     "ipv4" and "ipv6" are true if an address (except the loopback and the IPv6
+     link-local addresses) is configured
+*/
+YCPValue PkgFunctions::NetworkStatus(const YCPBoolean &refresh)
+{
+    const NetworkState &state = DetectNetwork(!refresh.isNull() && refresh->value());
+
+    YCPMap ret;
+    ret->add(YCPString("running"), YCPBoolean(state.ipv4 || state.ipv6));
+    ret->add(YCPString("ipv4"), YCPBoolean(state.ipv4));
+    ret->add(YCPString("ipv6"), YCPBoolean(state.ipv6));
+
+    return ret;
 }
 
 /*
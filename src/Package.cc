@@ -24,6 +24,7 @@
 #include "PkgFunctions.h"
 #include "log.h"
 #include "Callbacks.YCP.h"
+#include "CallbackQueue.h"
 
 #include <ycp/YCPVoid.h>
 #include <ycp/YCPBoolean.h>
@@ -41,10 +42,10 @@
 #include <zypp/ResStatus.h>
 
 #include <zypp/ResPool.h>
+#include <zypp/base/SerialNumber.h>
 #include <zypp/target/rpm/RpmDb.h>
 #include <zypp/target/TargetException.h>
 #include <zypp/ZYppCommit.h>
-#include <zypp/base/Regex.h>
 
 #include <zypp/sat/WhatProvides.h>
 #include <zypp/ZYppFactory.h>
@@ -55,6 +56,8 @@
 
 #include <fstream>
 #include <sstream>
+#include <exception>
+#include <thread>
 
 extern "C"
 {
@@ -284,9 +287,49 @@ PkgFunctions::PkgMediaNames ()
 
 YCPValue
 PkgFunctions::PkgMediaSizesOrCount (bool sizes, bool download_size)
+{
+    UpdateMediaSizes();
+
+    YCPList res;
+
+    for(std::map<RepoId, std::vector<MediaTotal> >::const_iterator it =
+	media_sizes.totals.begin(); it != media_sizes.totals.end() ; ++it)
+    {
+	const std::vector<MediaTotal> &values = it->second;
+	YCPList source;
+
+	// the media without any package at the end are not reported
+	unsigned int media = values.size();
+	while (media > 0 && values[media - 1].count == 0)
+	    --media;
+
+	for( unsigned i = 0 ; i < media ; i++ )
+	{
+	    zypp::ByteCount value = sizes ? (download_size ? values[i].download_size : values[i].install_size)
+		: zypp::ByteCount(values[i].count);
+	    source->add( YCPInteger( value ) );
+	}
+
+	res->add( source );
+    }
+
+    y2milestone( "Pkg::%s result: %s", sizes ? (download_size ? "PkgMediaPackageSizes" : "PkgMediaSizes" ): "PkgMediaCount", res->toString().c_str());
+
+    return res;
+}
+
+/*
+ * Update the media totals. libzypp does not notify about the status changes
+ * (e.g. the package selector changes the selectables directly), the selected
+ * packages are compared with the previous state, only the changed packages
+ * are looked up and added to or removed from the totals.
+ * A full recompute is done when the pool content or the enabled repositories
+ * have been changed.
+ */
+void PkgFunctions::UpdateMediaSizes()
 {
     // all enabled sources
-    std::list<RepoId> source_ids;
+    std::vector<RepoId> source_ids;
 
     RepoId index = 0;
     for(RepoCont::const_iterator it = repos.begin(); it != repos.end() ; ++it, ++index)
@@ -298,85 +341,107 @@ PkgFunctions::PkgMediaSizesOrCount (bool sizes, bool download_size)
 	source_ids.push_back(index);
     }
 
+    unsigned pool_serial = zypp::ResPool::instance().serial().serial();
 
-    // map SourceId -> [ number_of_media, total_size ]
-    std::map<RepoId, std::vector<zypp::ByteCount> > result;
-
-    // map alias -> SourceID
-    std::map<std::string, RepoId> source_map;
-
-    // initialize the structures
-    for( std::list<RepoId>::const_iterator sit = source_ids.begin();
-	sit != source_ids.end(); ++sit, ++index)
+    if (!media_sizes.valid || media_sizes.pool_serial != pool_serial || media_sizes.repos != source_ids)
     {
-	RepoId id = *sit;
+	y2milestone("Recomputing the media sizes");
 
-	YRepo_Ptr repo = logFindRepository(id);
-	if (!repo)
-	    continue;
+	media_sizes.packages.clear();
+	media_sizes.totals.clear();
 
 	// we don't know the number of media in advance
 	// the vector is dynamically resized during package search
-	result[id] = std::vector<zypp::ByteCount>();
-	source_map[ repo->repoInfo().alias() ] = id;
+	for (std::vector<RepoId>::const_iterator sit = source_ids.begin(); sit != source_ids.end(); ++sit)
+	    media_sizes.totals[*sit] = std::vector<MediaTotal>();
+
+	media_sizes.repos = source_ids;
+	media_sizes.pool_serial = pool_serial;
+	media_sizes.valid = true;
     }
 
+    unsigned int generation = ++media_sizes.generation;
+    int added = 0;
+    int removed = 0;
 
     for (zypp::ResPoolProxy::const_iterator it = zypp_ptr()->poolProxy().byKindBegin(zypp::ResKind::package);
         it != zypp_ptr()->poolProxy().byKindEnd(zypp::ResKind::package);
         ++it)
     {
-        if ((*it)->fate() == zypp::ui::Selectable::TO_INSTALL)
-	{
-	    zypp::Package::constPtr pkg = zypp::asKind<zypp::Package>((*it)->candidateObj().resolvable());
+        if ((*it)->fate() != zypp::ui::Selectable::TO_INSTALL)
+	    continue;
 
-	    if (!pkg)
-		continue;
+	zypp::PoolItem candidate = (*it)->candidateObj();
+	zypp::sat::detail::SolvableIdType id = candidate.satSolvable().id();
 
-	    unsigned int medium = pkg->mediaNr();
-	    if (medium == 0)
-	    {
-		medium = 1;
-	    }
+	std::unordered_map<zypp::sat::detail::SolvableIdType, MediaPackage>::iterator found = media_sizes.packages.find(id);
 
-	    if (medium > 0)
-	    {
-		zypp::ByteCount size = sizes ? (download_size ? pkg->downloadSize() : pkg->installSize()) : zypp::ByteCount(1); //count only
+	// already counted
+	if (found != media_sizes.packages.end())
+	{
+	    found->second.generation = generation;
+	    continue;
+	}
 
-		// refence to the found media array
-		std::vector<zypp::ByteCount> &ref = result[source_map[pkg->repoInfo().alias()]];
-		int add_count = (medium - 1) - ref.size() + 1;
+	zypp::Package::constPtr pkg = zypp::asKind<zypp::Package>(candidate.resolvable());
 
-		// resize media array - the found index is out of array
-		if (add_count > 0)
-		{
-                    ref.insert(ref.end(), add_count, zypp::ByteCount(0));
-		}
+	if (!pkg)
+	    continue;
 
-		ref[medium - 1] += size ;	// media are numbered from 1
-	    }
+	MediaPackage package;
+
+	package.medium = pkg->mediaNr();
+	if (package.medium == 0)
+	{
+	    package.medium = 1;
 	}
-    }
 
-    YCPList res;
+	// packages from an unknown or disabled repository are counted in the first repository
+	package.repo = logFindRepo(pkg->repository());
+	if (media_sizes.totals.find(package.repo) == media_sizes.totals.end())
+	    package.repo = 0;
 
-    for(std::map<RepoId, std::vector<zypp::ByteCount> >::const_iterator it =
-	result.begin(); it != result.end() ; ++it)
-    {
-	const std::vector<zypp::ByteCount> &values = it->second;
-	YCPList source;
+	package.install_size = pkg->installSize();
+	package.download_size = pkg->downloadSize();
+	package.generation = generation;
+
+	// refence to the found media array
+	std::vector<MediaTotal> &ref = media_sizes.totals[package.repo];
+
+	// resize media array - the found index is out of array
+	if (ref.size() < package.medium)
+	    ref.resize(package.medium);
+
+	// media are numbered from 1
+	MediaTotal &total = ref[package.medium - 1];
+	total.install_size += package.install_size;
+	total.download_size += package.download_size;
+	++total.count;
 
-	for( unsigned i = 0 ; i < values.size() ; i++ )
+	media_sizes.packages[id] = package;
+	++added;
+    }
+
+    // remove the packages which are not selected anymore
+    for (std::unordered_map<zypp::sat::detail::SolvableIdType, MediaPackage>::iterator it = media_sizes.packages.begin();
+	it != media_sizes.packages.end();)
+    {
+	if (it->second.generation == generation)
 	{
-	    source->add( YCPInteger( values[i] ) );
+	    ++it;
+	    continue;
 	}
 
-	res->add( source );
-    }
+	MediaTotal &total = media_sizes.totals[it->second.repo][it->second.medium - 1];
+	total.install_size -= it->second.install_size;
+	total.download_size -= it->second.download_size;
+	--total.count;
 
-    y2milestone( "Pkg::%s result: %s", sizes ? (download_size ? "PkgMediaPackageSizes" : "PkgMediaSizes" ): "PkgMediaCount", res->toString().c_str());
+	it = media_sizes.packages.erase(it);
+	++removed;
+    }
 
-    return res;
+    y2debug("Media sizes updated: %d added, %d removed, %zd selected", added, removed, media_sizes.packages.size());
 }
 
 // ------------------------
@@ -910,7 +975,7 @@ PkgFunctions::PkgProp(const zypp::PoolItem &item)
     data->add( YCPString("arch"), YCPString( pkg->arch().asString() ) );
     data->add( YCPString("medianr"), YCPInteger( pkg->mediaNr() ) );
 
-    long long sid = logFindAlias(pkg->repoInfo().alias());
+    long long sid = logFindRepo(pkg->repository());
     y2debug("srcId: %lld", sid );
     data->add( YCPString("srcid"), YCPInteger( sid ) );
 
@@ -1271,6 +1336,150 @@ PkgFunctions::ClearSaveState ()
     return YCPBoolean (true);
 }
 
+// ------------------------
+/**
+   @builtin SaveNamedState
+   @short Save the current selection state under a name
+   @description
+   Unlike Pkg::SaveState() more states can be saved, they are identified by name.
+   An existing state with the same name is replaced. The states are dropped when
+   the resolvable pool is changed (e.g. a repository is added or removed).
+
+   @param string name name of the state
+   @return boolean
+   @see Pkg::RestoreNamedState
+
+*/
+YCPValue
+PkgFunctions::SaveNamedState (const YCPString& name)
+{
+    if (name.isNull())
+    {
+	y2error("Missing state name");
+	return YCPBoolean(false);
+    }
+
+    try
+    {
+	selection_snapshots.save(name->value());
+    }
+    catch (const zypp::Exception &excpt)
+    {
+	_last_error.setLastError(ExceptionAsString(excpt));
+	return YCPBoolean(false);
+    }
+
+    return YCPBoolean(true);
+}
+
+// ------------------------
+/**
+   @builtin RestoreNamedState
+   @short Restore the selection state saved by Pkg::SaveNamedState()
+   @description
+   Only the resolvables with a different status are changed, the state is kept
+   so it can be restored again.
+
+   @param string name name of the state
+   @return integer number of changed resolvables, nil if the state has not been saved
+   @see Pkg::SaveNamedState
+
+*/
+YCPValue
+PkgFunctions::RestoreNamedState (const YCPString& name)
+{
+    if (name.isNull())
+    {
+	y2error("Missing state name");
+	return YCPVoid();
+    }
+
+    int restored = -1;
+
+    try
+    {
+	restored = selection_snapshots.restore(name->value());
+    }
+    catch (const zypp::Exception &excpt)
+    {
+	_last_error.setLastError(ExceptionAsString(excpt));
+	return YCPVoid();
+    }
+
+    if (restored < 0)
+	return YCPVoid();
+
+    return YCPInteger(restored);
+}
+
+// ------------------------
+/**
+   @builtin DeleteNamedState
+   @short Delete a state saved by Pkg::SaveNamedState()
+   @param string name name of the state
+   @return boolean false if the state has not been saved
+
+*/
+YCPValue
+PkgFunctions::DeleteNamedState (const YCPString& name)
+{
+    if (name.isNull())
+	return YCPBoolean(false);
+
+    return YCPBoolean(selection_snapshots.remove(name->value()));
+}
+
+// ------------------------
+/**
+   @builtin NamedStates
+   @short Names of the states saved by Pkg::SaveNamedState()
+   @return list<string>
+
+*/
+YCPValue
+PkgFunctions::NamedStates ()
+{
+    return selection_snapshots.names();
+}
+
+// ------------------------
+/**
+   @builtin NamedStateDiff
+   @short Compare two states saved by Pkg::SaveNamedState()
+   @description
+   Returns the resolvables which would be changed by restoring the state "to" when
+   the state "from" is active. An empty name means the current state, comparing saved
+   states is fast, the current state needs to check the whole pool.
+
+   <code>
+   $[ `install : [ $["name" : "yast2", "kind" : `package, "version" : "4.0-1.1", "arch" : "x86_64"] ],
+      `remove : [], `neutral : [], `lock : [], `unlock : [] ]
+   </code>
+
+   @param string from name of the state (or "" for the current state)
+   @param string to name of the state (or "" for the current state)
+   @return map the changes, nil if a state has not been saved
+
+*/
+YCPValue
+PkgFunctions::NamedStateDiff (const YCPString& from, const YCPString& to)
+{
+    YCPMap ret;
+
+    try
+    {
+	if (!selection_snapshots.diff(from.isNull() ? "" : from->value(), to.isNull() ? "" : to->value(), ret))
+	    return YCPVoid();
+    }
+    catch (const zypp::Exception &excpt)
+    {
+	_last_error.setLastError(ExceptionAsString(excpt));
+	return YCPVoid();
+    }
+
+    return ret;
+}
+
 // ------------------------
 /**
    @builtin IsManualSelection
@@ -1536,6 +1745,7 @@ PkgFunctions::PkgUpdateAll (const YCPMap& options)
 	zypp_ptr()->resolver()->setIgnoreAlreadyRecommended(false);
 
 	// solve upgrade, get statistics
+	solver_cache.invalidate();
 	zypp_ptr()->resolver()->doUpgrade();
     }
     catch (...)
@@ -1876,6 +2086,8 @@ YCPValue PkgFunctions::SetSolverFlags(const YCPMap& params)
 	{
 	    y2milestone("Resetting the solver");
 	    solver->reset();
+	    // the extra requires/conflicts have been removed
+	    solver_cache.invalidate();
 	    // reset also the dist upgrade flag (set by PkgUpdateAll())
 	    solver->setUpgradeMode(false);
 	}
@@ -2002,6 +2214,9 @@ PkgFunctions::SetAdditionalVendors (const YCPList &vendorycplist)
       else {
 	zypp::VendorAttr::noTargetInstance().addVendorList(vendors);
       }
+
+      // the vendor equivalence is not part of the solver cache fingerprint
+      solver_cache.invalidate();
     }
 
     catch (const zypp::Exception& ex)
@@ -2019,6 +2234,11 @@ PkgFunctions::SetAdditionalVendors (const YCPList &vendorycplist)
 /**
    @builtin PkgSolve
    @short Solve current package dependencies
+   @description
+   When the user and application selections, the solver flags and the requested
+   locales have not changed since the previous call the solver is not run again,
+   the previous result is used (see PkgSolveCacheStats).
+
    @optarg boolean filter  unused, only for backward compatibility
    (installed packages will be preferred)
    @return boolean
@@ -2028,10 +2248,18 @@ YCPBoolean
 PkgFunctions::PkgSolve (const YCPBoolean& filter)
 {
     bool result = false;
+    bool solved = false;
+    zypp::Resolver_Ptr resolver = zypp_ptr()->resolver();
+    size_t fingerprint = SolverCache::fingerprint(resolver);
+
+    // the badlist file has been written by the cached run
+    if (solver_cache.lookup(fingerprint, result))
+	return YCPBoolean(result);
 
     try
     {
-	result = zypp_ptr()->resolver()->resolvePool();
+	result = resolver->resolvePool();
+	solved = true;
     }
     catch (const zypp::Exception& excpt)
     {
@@ -2040,16 +2268,51 @@ PkgFunctions::PkgSolve (const YCPBoolean& filter)
 	result = false;
     }
 
+    zypp::ResolverProblemList problems;
+
     // save information about failed dependencies to file
     if (!result)
     {
-	zypp::ResolverProblemList problems = zypp_ptr()->resolver()->problems();
+	problems = resolver->problems();
 	SaveProblemList(problems, "/var/log/YaST2/badlist");
     }
 
+    if (solved)
+	solver_cache.store(fingerprint, result, problems);
+    else
+	solver_cache.invalidate();
+
     return YCPBoolean(result);
 }
 
+/**
+   @builtin PkgSolveCacheStats
+   @short Statistics of the PkgSolve result cache
+   @description
+   Returns how many PkgSolve calls used the previous solver result ("hits")
+   and how many calls had to run the solver ("misses").
+   @return map<string,integer>
+   @usage Pkg::PkgSolveCacheStats() -> $["hits" : 3, "misses" : 1]
+*/
+YCPValue
+PkgFunctions::PkgSolveCacheStats()
+{
+    YCPMap ret;
+    ret->add(YCPString("hits"), YCPInteger(solver_cache.hits()));
+    ret->add(YCPString("misses"), YCPInteger(solver_cache.misses()));
+    return ret;
+}
+
+zypp::ResolverProblemList
+PkgFunctions::SolverProblems()
+{
+    // the resolver would create the same problems again
+    if (solver_cache.valid())
+	return solver_cache.problems();
+
+    return zypp_ptr()->resolver()->problems();
+}
+
 /**
    @builtin PkgSolveCheckTargetOnly
 
@@ -2066,6 +2329,7 @@ PkgFunctions::PkgSolveCheckTargetOnly()
     try
     {
 	zypp_ptr()->target()->load();
+	product_cache.clear();
     }
     catch (...)
     {
@@ -2077,6 +2341,7 @@ PkgFunctions::PkgSolveCheckTargetOnly()
     try
     {
 	// verify consistency of system
+	solver_cache.invalidate();
 	result = zypp_ptr()->resolver()->verifySystem();
     }
     catch (const zypp::Exception& excpt)
@@ -2103,7 +2368,7 @@ PkgFunctions::PkgSolveErrors()
 {
     try
     {
-	return YCPInteger(zypp_ptr()->resolver()->problems().size());
+	return YCPInteger(SolverProblems().size());
     }
     catch (...)
     {
@@ -2171,7 +2436,7 @@ YCPValue
 PkgFunctions::PkgSolveProblems()
 {
     YCPList ret;
-    auto problems = zypp_ptr()->resolver()->problems();
+    auto problems = SolverProblems();
     for_( problem, problems.begin(), problems.end() )
     {
         YCPMap problem_item;
@@ -2289,7 +2554,7 @@ PkgFunctions::PkgSetSolveSolutions(const YCPList& solutions)
         std::string solution_description = solution->value(YCPString("solution_description"))->asString()->value();
         std::string solution_details = solution->value(YCPString("solution_details"))->asString()->value();
 
-        auto problems = zypp_ptr()->resolver()->problems();
+        auto problems = SolverProblems();
         bool found = false;
         for_( problem, problems.begin(), problems.end() )
         {
@@ -2317,6 +2582,7 @@ PkgFunctions::PkgSetSolveSolutions(const YCPList& solutions)
 
     y2milestone("Applying %ld solutions", user_solutions.size());
     zypp::getZYpp()->resolver()->applySolutions(user_solutions);
+    solver_cache.invalidate();
 
     return YCPBoolean(!error);
 }
@@ -2347,6 +2613,7 @@ PkgFunctions::PkgResetSolveSolutions()
     // the name is a bit confusing, it does not revert just the last change
     // but resets everything
     zypp::getZYpp()->resolver()->undo();
+    solver_cache.invalidate();
     return YCPVoid();
 }
 
@@ -2425,9 +2692,10 @@ namespace
   ///////////////////////////////////////////////////////////////////
 } // namespace
 
-YCPValue PkgFunctions::CommitHelper(const zypp::ZYppCommitPolicy *policy)
+YCPValue PkgFunctions::CommitHelper(const zypp::ZYppCommitPolicy *policy, const CommitPipeline::Settings &pipeline_settings)
 {
-    OldStyleCommitResult result;
+    zypp::ZYppCommitResult result;
+    std::unique_ptr<CommitPipeline> pipeline;
 
     // clean the last reported source
     // DownloadResolvableReceive::last_source_id = -1;
@@ -2439,11 +2707,23 @@ YCPValue PkgFunctions::CommitHelper(const zypp::ZYppCommitPolicy *policy)
 	last_reported_repo = -1;
 	last_reported_mediumnr = 1;
 
-	result = OldStyleCommitResult( zypp_ptr()->commit(*policy) );
+	if (pipeline_settings.enabled)
+	{
+	    pipeline.reset(CreateCommitPipeline(pipeline_settings));
+	    commit_pipeline = pipeline.get();
+	    pipeline->start();
+
+	    // aborted while waiting for the first package
+	    if (pipeline->aborted())
+		ZYPP_THROW(zypp::target::TargetAbortedException("Commit aborted by user"));
+	}
+
+	result = zypp_ptr()->commit(*policy);
     }
     catch (const zypp::target::TargetAbortedException & excpt)
     {
 	y2milestone ("Installation aborted by user");
+	commit_pipeline = NULL;
 	YCPList ret;
 	ret->add(YCPInteger(-1));
 	return ret;
@@ -2451,12 +2731,54 @@ YCPValue PkgFunctions::CommitHelper(const zypp::ZYppCommitPolicy *policy)
     catch (const zypp::Exception& excpt)
     {
 	y2error("Pkg::Commit has failed: ZYpp::commit has failed");
+	commit_pipeline = NULL;
 	_last_error.setLastError(ExceptionAsString(excpt));
 	return YCPVoid();
     }
 
+    // the commit info is returned only in the pipeline mode,
+    // keep the documented result of the other modes
+    YCPMap info;
+    if (pipeline)
+	info = CommitInfo();
+    commit_pipeline = NULL;
+
+    return CommitResultHelper(result, info);
+}
+
+CommitPipeline *PkgFunctions::CreateCommitPipeline(const CommitPipeline::Settings &settings)
+{
+    // the forked download workers must not evaluate any YCP callback
+    return new CommitPipeline(settings, [this] { _callbackHandler.disconnectReceivers(); });
+}
+
+/*
+ The settings used by the running commit (see CommitPolicy()), with the
+ download pipeline timing
+*/
+YCPMap PkgFunctions::CommitInfo()
+{
+    YCPMap info(CommitPolicy()->asMap());
+
+    if (commit_pipeline)
+	info->add(YCPString("packages"), commit_pipeline->timing());
+
+    return info;
+}
+
+/*
+ Helper function for converting the commit result to the list returned by Commit(),
+ an empty commit_info map is not added to the result
+*/
+YCPValue PkgFunctions::CommitResultHelper(const zypp::ZYppCommitResult &commit_result, const YCPMap &commit_info)
+{
+    OldStyleCommitResult result(commit_result);
+
     SourceReleaseAll();
 
+    // the installed products and the product files have been changed
+    product_cache.clear();
+
     // create the base product link (bnc#413444)
     CreateBaseProductSymlink();
 
@@ -2525,6 +2847,10 @@ YCPValue PkgFunctions::CommitHelper(const zypp::ZYppCommitPolicy *policy)
   }
   ret->add(msglist);
 
+    // the used commit settings
+    if (commit_info->size() > 0)
+	ret->add(commit_info);
+
     return ret;
 }
 
@@ -2566,6 +2892,11 @@ YCPValue PkgFunctions::CommitPolicy()
 	ret->add(YCPString("download_mode"), YCPSymbol(mode));
     }
 
+    // the download-ahead mode (overrides the download mode)
+    if (commit_pipeline)
+    {
+	commit_pipeline->addSettings(ret);
+    }
 
     return ret;
 }
@@ -2595,10 +2926,17 @@ PkgFunctions::PkgCommit (const YCPInteger& media)
 	return YCPError ("Bad args to Pkg::PkgCommit");
     }
 
+    if (commit_job)
+    {
+	y2error("An asynchronous commit is running");
+	_last_error.setLastError("An asynchronous commit is running");
+	return YCPVoid();
+    }
+
     commit_policy = new zypp::ZYppCommitPolicy;
     commit_policy->restrictToMedia(medianr);
 
-    YCPValue ret = CommitHelper(commit_policy);
+    YCPValue ret = CommitHelper(commit_policy, CommitPipeline::Settings());
 
     delete commit_policy;
     commit_policy = NULL;
@@ -2606,27 +2944,12 @@ PkgFunctions::PkgCommit (const YCPInteger& media)
     return ret;
 }
 
-/**
- * @builtin Commit
- *
- * @short Commit package changes (actually install/delete packages)
- * @description
- *
- * @param map commit configuration, currently supported values:
- *   $["download_mode":`default|`download_only|`download_only|`download_in_advance|
- *      `download_in_heaps|`download_as_needed, "medium_nr":<integer>,
- *      "dry_run":<boolean>, "exclude_docs":<boolean>, "no_signature":<boolean>],
- *   the default is $["download_mode":`default, "medium_nr":0 (all media),
- *      "dry_run":false, "exclude_docs":false, "no_signature":false],
- *
- *  @return list [ int successful, list failed, list remaining, list srcremaining, list update_messages ]
- * The 'successful' value will be negative, if installation was aborted !
+/*
+ Helper function for parsing the Commit() configuration,
+ returns false (and sets the last error) if the configuration is invalid
 */
-/* TYPEINFO: list<any>(integer)*/
-YCPValue PkgFunctions::Commit (const YCPMap& config)
+bool PkgFunctions::ParseCommitPolicy(const YCPMap &config, zypp::ZYppCommitPolicy &policy, CommitPipeline::Settings &pipeline)
 {
-    commit_policy = new zypp::ZYppCommitPolicy;
-
     if (!config.isNull())
     {
         YCPString key("download_mode");
@@ -2640,33 +2963,37 @@ YCPValue PkgFunctions::Commit (const YCPMap& config)
 
                 if (mode == "default")
                 {
-                    commit_policy->downloadMode(zypp::DownloadDefault);
+                    policy.downloadMode(zypp::DownloadDefault);
                 }
                 else if (mode == "download_only")
                 {
-                    commit_policy->downloadMode(zypp::DownloadOnly);
+                    policy.downloadMode(zypp::DownloadOnly);
                 }
                 else if (mode == "download_in_advance")
                 {
-                    commit_policy->downloadMode(zypp::DownloadInAdvance);
+                    policy.downloadMode(zypp::DownloadInAdvance);
                 }
                 else if (mode == "download_in_heaps")
                 {
-                    commit_policy->downloadMode(zypp::DownloadInHeaps);
+                    policy.downloadMode(zypp::DownloadInHeaps);
                 }
                 else if (mode == "download_as_needed")
                 {
-                    commit_policy->downloadMode(zypp::DownloadAsNeeded);
+                    policy.downloadMode(zypp::DownloadAsNeeded);
+                }
+                else if (mode == "download_pipeline")
+                {
+                    // libzypp downloads the packages one by one, the next
+                    // packages are downloaded ahead by the CommitPipeline
+                    policy.downloadMode(zypp::DownloadAsNeeded);
+                    pipeline.enabled = true;
                 }
                 else
                 {
                     y2error("Invalid download mode: %s", mode.c_str());
                     _last_error.setLastError(std::string("Invalid download mode: ") + mode);
 
-		    delete commit_policy;
-		    commit_policy = NULL;
-
-                    return YCPVoid();
+                    return false;
                 }
 
                 y2milestone("Using download mode: %s", mode.c_str());
@@ -2676,10 +3003,7 @@ YCPValue PkgFunctions::Commit (const YCPMap& config)
                 y2error("Invalid download mode: symbol is required, got: %s", config->value(key)->asString()->value().c_str());
                 _last_error.setLastError(std::string("Invalid download mode: ") + config->value(key)->asString()->value());
 
-		delete commit_policy;
-		commit_policy = NULL;
-
-                return YCPVoid();
+                return false;
             }
         }
 
@@ -2690,7 +3014,7 @@ YCPValue PkgFunctions::Commit (const YCPMap& config)
             if (config->value(key)->isInteger())
             {
                 unsigned medium_nr = config->value(key)->asInteger()->value();
-                commit_policy->restrictToMedia(medium_nr);
+                policy.restrictToMedia(medium_nr);
 
                 y2milestone("Restricting commit only to medium number: %u", medium_nr);
             }
@@ -2699,10 +3023,7 @@ YCPValue PkgFunctions::Commit (const YCPMap& config)
                 y2error("Invalid medium number: integer is required, got: %s", config->value(key)->asString()->value().c_str());
                 _last_error.setLastError(std::string("Invalid medium number: ") + config->value(key)->asString()->value());
 
-		delete commit_policy;
-		commit_policy = NULL;
-
-                return YCPVoid();
+                return false;
             }
         }
 
@@ -2713,7 +3034,7 @@ YCPValue PkgFunctions::Commit (const YCPMap& config)
             if (config->value(key)->isBoolean())
             {
                 bool dry_run = config->value(key)->asBoolean()->value();
-                commit_policy->dryRun(dry_run);
+                policy.dryRun(dry_run);
 
                 y2milestone("Dry run commit: %s", config->value(key)->asString()->value().c_str());
             }
@@ -2722,10 +3043,7 @@ YCPValue PkgFunctions::Commit (const YCPMap& config)
                 y2error("Dry run option: boolean is required, got: %s", config->value(key)->asString()->value().c_str());
                 _last_error.setLastError(std::string("Invalid dry run option: ") + config->value(key)->asString()->value());
 
-		delete commit_policy;
-		commit_policy = NULL;
-
-                return YCPVoid();
+                return false;
             }
         }
 
@@ -2736,7 +3054,7 @@ YCPValue PkgFunctions::Commit (const YCPMap& config)
             if (config->value(key)->isBoolean())
             {
                 bool exclude_docs = config->value(key)->asBoolean()->value();
-                commit_policy->rpmExcludeDocs(exclude_docs);
+                policy.rpmExcludeDocs(exclude_docs);
 
                 y2milestone("Excluding documentation: %s", config->value(key)->toString().c_str());
             }
@@ -2745,10 +3063,7 @@ YCPValue PkgFunctions::Commit (const YCPMap& config)
                 y2error("Exclude documentation option: boolean is required, got: %s", config->value(key)->toString().c_str());
                 _last_error.setLastError(std::string("Invalid exclude documentation option: ") + config->value(key)->toString());
 
-		delete commit_policy;
-		commit_policy = NULL;
-
-                return YCPVoid();
+                return false;
             }
         }
 
@@ -2759,7 +3074,7 @@ YCPValue PkgFunctions::Commit (const YCPMap& config)
             if (config->value(key)->isBoolean())
             {
                 bool no_signature = config->value(key)->asBoolean()->value();
-                commit_policy->rpmNoSignature(no_signature);
+                policy.rpmNoSignature(no_signature);
 
                 y2milestone("Don't check RPM signature: %s", config->value(key)->toString().c_str());
             }
@@ -2768,15 +3083,98 @@ YCPValue PkgFunctions::Commit (const YCPMap& config)
                 y2error("No signature option: boolean is required, got: %s", config->value(key)->toString().c_str());
                 _last_error.setLastError(std::string("Invalid no signature option: ") + config->value(key)->toString());
 
-		delete commit_policy;
-		commit_policy = NULL;
+                return false;
+            }
+        }
+
+        // the download pipeline settings
+        auto pipeline_option = [&](const char *name, long long min, long long &value) -> bool
+        {
+            YCPValue val = config->value(YCPString(name));
+
+            if (val.isNull())
+                return true;
 
-                return YCPVoid();
+            if (!val->isInteger() || val->asInteger()->value() < min)
+            {
+                y2error("Invalid %s option: integer >= %lld is required, got: %s", name, min, val->toString().c_str());
+                _last_error.setLastError(std::string("Invalid ") + name + " option: " + val->toString());
+                return false;
             }
+
+            value = val->asInteger()->value();
+            return true;
+        };
+
+        long long packages = pipeline.packages;
+        long long bytes = pipeline.bytes;
+        long long connections = pipeline.connections;
+
+        if (!pipeline_option("prefetch_packages", 1, packages)
+            || !pipeline_option("prefetch_bytes", 0, bytes)
+            || !pipeline_option("connections", 1, connections))
+        {
+            return false;
         }
+
+        pipeline.packages = packages;
+        pipeline.bytes = bytes;
+        pipeline.connections = connections;
+    }
+
+    return true;
+}
+
+/**
+ * @builtin Commit
+ *
+ * @short Commit package changes (actually install/delete packages)
+ * @description
+ *
+ * @param map commit configuration, currently supported values:
+ *   $["download_mode":`default|`download_only|`download_only|`download_in_advance|
+ *      `download_in_heaps|`download_as_needed|`download_pipeline, "medium_nr":<integer>,
+ *      "dry_run":<boolean>, "exclude_docs":<boolean>, "no_signature":<boolean>,
+ *      "prefetch_packages":<integer>, "prefetch_bytes":<integer>, "connections":<integer>],
+ *   the default is $["download_mode":`default, "medium_nr":0 (all media),
+ *      "dry_run":false, "exclude_docs":false, "no_signature":false],
+ *
+ *   `download_pipeline downloads the next packages while the current one is being
+ *   installed, "prefetch_packages" (default 4) and "prefetch_bytes" (default 0 = unlimited)
+ *   limit how far ahead the packages are downloaded, "connections" (default 2) is
+ *   the number of parallel downloads. The other modes ignore these values.
+ *   While the commit waits for a package downloaded ahead the ProgressStart,
+ *   ProgressProgress and ProgressDone callbacks are evaluated, returning false
+ *   from ProgressProgress aborts the commit.
+ *
+ *  @return list [ int successful, list failed, list remaining, list srcremaining, list update_messages ]
+ * The 'successful' value will be negative, if installation was aborted !
+ * In the `download_pipeline mode the list contains also a 'commit_info' map with the used
+ * settings (see Pkg::CommitPolicy()) and "packages": list of $["name", "version", "arch",
+ * "download_time", "install_time", "prefetched"] maps (times in ms, -1 = not measured).
+*/
+/* TYPEINFO: list<any>(integer)*/
+YCPValue PkgFunctions::Commit (const YCPMap& config)
+{
+    if (commit_job)
+    {
+	y2error("An asynchronous commit is running");
+	_last_error.setLastError("An asynchronous commit is running");
+	return YCPVoid();
+    }
+
+    commit_policy = new zypp::ZYppCommitPolicy;
+    CommitPipeline::Settings pipeline;
+
+    if (!ParseCommitPolicy(config, *commit_policy, pipeline))
+    {
+	delete commit_policy;
+	commit_policy = NULL;
+
+	return YCPVoid();
     }
 
-    YCPValue ret = CommitHelper(commit_policy);
+    YCPValue ret = CommitHelper(commit_policy, pipeline);
 
     delete commit_policy;
     commit_policy = NULL;
@@ -2784,6 +3182,299 @@ YCPValue PkgFunctions::Commit (const YCPMap& config)
     return ret;
 }
 
+/*
+ A commit started by AsyncCommit(). ZYpp::commit() runs in a separate thread,
+ the callbacks are passed to the main thread through the queue.
+*/
+class CommitJob
+{
+  public:
+
+    CommitJob(long long job_id) : id(job_id) {}
+
+    ~CommitJob()
+    {
+	// the worker might be blocked in a callback, release it and wait
+	queue.requestAbort();
+	queue.close();
+	wait();
+    }
+
+    void start(zypp::ZYpp *zypp)
+    {
+	thread = std::thread([this, zypp]
+	{
+	    try
+	    {
+		result = zypp->commit(policy);
+	    }
+	    catch (...)
+	    {
+		// rethrown in the main thread by CommitResult()
+		error = std::current_exception();
+	    }
+
+	    queue.finish();
+	});
+    }
+
+    void wait()
+    {
+	if (thread.joinable())
+	    thread.join();
+    }
+
+    long long id;
+    zypp::ZYppCommitPolicy policy;
+    CommitPipeline::Settings pipeline_settings;
+    CallbackQueue queue;
+    std::thread thread;
+
+    // the commit result, valid after the queue is finished
+    zypp::ZYppCommitResult result;
+    std::exception_ptr error;
+};
+
+std::shared_ptr<CommitJob> PkgFunctions::FindCommitJob(const YCPInteger &handle)
+{
+    if (handle.isNull() || !commit_job || commit_job->id != handle->value())
+    {
+	y2error("Invalid commit handle: %s", handle.isNull() ? "nil" : handle->toString().c_str());
+	_last_error.setLastError("Invalid commit handle");
+	return std::shared_ptr<CommitJob>();
+    }
+
+    return commit_job;
+}
+
+bool PkgFunctions::CallAllowed(const std::string &builtin)
+{
+    if (!commit_job)
+	return true;
+
+    // libzypp is not thread safe, the other builtins would access it
+    // concurrently with the commit thread
+    if (builtin == "CommitPoll" || builtin == "CommitResult" || builtin == "CommitAbort"
+	|| builtin == "LastError" || builtin == "LastErrorDetails")
+	return true;
+
+    y2error("Pkg::%s cannot be called while the asynchronous commit is running", builtin.c_str());
+    _last_error.setLastError("Pkg::" + builtin + " cannot be called while the asynchronous commit is running");
+
+    return false;
+}
+
+void PkgFunctions::AbortAsyncCommit()
+{
+    if (!commit_job)
+	return;
+
+    y2warning("Aborting the asynchronous commit %lld", commit_job->id);
+
+    // the destructor waits for the worker thread, keep the queue set
+    // until the thread is finished
+    commit_job.reset();
+    _callbackHandler._ycpCallbacks.setQueue(NULL);
+    commit_policy = NULL;
+    commit_pipeline = NULL;
+}
+
+/**
+ * @builtin AsyncCommit
+ *
+ * @short Start the commit in a separate thread
+ * @description
+ * Start the same commit as Pkg::Commit() but do not wait until it is finished.
+ * The callbacks are evaluated in Pkg::CommitPoll() and Pkg::CommitResult() calls,
+ * the progress callbacks are only queued so a slow progress update does not block
+ * the installation, the other callbacks (e.g. media change, problem reports)
+ * block the commit until they are evaluated. If a progress callback returns false
+ * the commit is aborted.
+ *
+ * Only one asynchronous commit can run at a time. Until Pkg::CommitResult() is called
+ * only Pkg::CommitPoll(), Pkg::CommitResult(), Pkg::CommitAbort(), Pkg::LastError()
+ * and Pkg::LastErrorDetails() can be called, the other Pkg functions (also when called
+ * from the callbacks) fail and return nil.
+ *
+ * The `download_pipeline mode is not supported, the download workers cannot be
+ * forked from the multithreaded process, the packages are downloaded as needed.
+ *
+ * @param map commit configuration, see Pkg::Commit()
+ * @return integer commit handle, nil on error
+ */
+YCPValue PkgFunctions::AsyncCommit(const YCPMap& config)
+{
+    if (commit_job)
+    {
+	y2error("An asynchronous commit is already running");
+	_last_error.setLastError("An asynchronous commit is already running");
+	return YCPVoid();
+    }
+
+    if (commit_policy)
+    {
+	y2error("Commit is already running");
+	_last_error.setLastError("Commit is already running");
+	return YCPVoid();
+    }
+
+    std::shared_ptr<CommitJob> job = std::make_shared<CommitJob>(++last_commit_id);
+
+    if (!ParseCommitPolicy(config, job->policy, job->pipeline_settings))
+    {
+	return YCPVoid();
+    }
+
+    zypp::ZYpp *zypp = NULL;
+
+    try
+    {
+	zypp = zypp_ptr().get();
+    }
+    catch (const zypp::Exception& excpt)
+    {
+	_last_error.setLastError(ExceptionAsString(excpt));
+	return YCPVoid();
+    }
+
+    // reset the values for SourceChanged callback
+    last_reported_repo = -1;
+    last_reported_mediumnr = 1;
+
+    commit_job = job;
+    commit_policy = &job->policy;
+
+    // the download workers would be forked from the commit thread, a child forked
+    // from a multithreaded process must not use libzypp (a lock might be held
+    // by another thread)
+    if (job->pipeline_settings.enabled)
+    {
+	y2warning("The download pipeline is not supported in the asynchronous commit, using download as needed");
+	job->pipeline_settings.enabled = false;
+    }
+
+    _callbackHandler._ycpCallbacks.setQueue(&job->queue);
+
+    y2milestone("Starting asynchronous commit %lld", job->id);
+    job->start(zypp);
+
+    return YCPInteger(job->id);
+}
+
+/**
+ * @builtin CommitPoll
+ *
+ * @short Evaluate the callbacks of the asynchronous commit
+ * @description
+ * Wait for the callbacks triggered by the commit started by Pkg::AsyncCommit()
+ * and evaluate them. Returns when some callbacks have been evaluated, after
+ * the timeout or when the commit is finished.
+ *
+ * @param integer handle commit handle returned by Pkg::AsyncCommit()
+ * @param integer timeout max. waiting time in milliseconds (0 = do not wait)
+ * @return boolean true if the commit is finished (call Pkg::CommitResult()
+ *   to get the result), false if it is still running, nil on error
+ */
+YCPValue PkgFunctions::CommitPoll(const YCPInteger &handle, const YCPInteger &timeout)
+{
+    std::shared_ptr<CommitJob> job = FindCommitJob(handle);
+
+    if (!job)
+	return YCPVoid();
+
+    int timeout_ms = timeout.isNull() ? 0 : timeout->value();
+    _callbackHandler._ycpCallbacks.processQueue(timeout_ms);
+
+    return YCPBoolean(job->queue.finished());
+}
+
+/**
+ * @builtin CommitAbort
+ *
+ * @short Abort the asynchronous commit
+ * @description
+ * Request aborting the commit started by Pkg::AsyncCommit(), the same as returning
+ * false from a progress callback. The commit stops at the next progress report,
+ * call Pkg::CommitResult() to wait for it and to get the result.
+ *
+ * @param integer handle commit handle returned by Pkg::AsyncCommit()
+ * @return boolean true on success, false if the handle is not valid
+ */
+YCPValue PkgFunctions::CommitAbort(const YCPInteger &handle)
+{
+    std::shared_ptr<CommitJob> job = FindCommitJob(handle);
+
+    if (!job)
+	return YCPBoolean(false);
+
+    y2milestone("Aborting the asynchronous commit %lld", job->id);
+    job->queue.requestAbort();
+
+    return YCPBoolean(true);
+}
+
+/**
+ * @builtin CommitResult
+ *
+ * @short Get the result of the asynchronous commit
+ * @description
+ * Wait until the commit started by Pkg::AsyncCommit() is finished (the pending
+ * callbacks are evaluated while waiting) and return the result. The handle
+ * is invalid after this call.
+ *
+ * @param integer handle commit handle returned by Pkg::AsyncCommit()
+ * @return list the same result as Pkg::Commit() with the 'commit_info' map
+ *   (without the "packages" timing), nil on error
+ */
+YCPValue PkgFunctions::CommitResult(const YCPInteger &handle)
+{
+    std::shared_ptr<CommitJob> job = FindCommitJob(handle);
+
+    if (!job)
+	return YCPVoid();
+
+    while (!job->queue.finished())
+	_callbackHandler._ycpCallbacks.processQueue(100);
+
+    job->wait();
+
+    YCPMap info(CommitInfo());
+
+    commit_job.reset();
+    _callbackHandler._ycpCallbacks.setQueue(NULL);
+    commit_policy = NULL;
+    commit_pipeline = NULL;
+
+    y2milestone("Asynchronous commit %lld finished", job->id);
+
+    try
+    {
+	if (job->error)
+	    std::rethrow_exception(job->error);
+    }
+    catch (const zypp::target::TargetAbortedException & excpt)
+    {
+	y2milestone ("Installation aborted by user");
+	YCPList ret;
+	ret->add(YCPInteger(-1));
+	return ret;
+    }
+    catch (const zypp::Exception& excpt)
+    {
+	y2error("Pkg::CommitResult: ZYpp::commit has failed");
+	_last_error.setLastError(ExceptionAsString(excpt));
+	return YCPVoid();
+    }
+    catch (const std::exception& excpt)
+    {
+	y2error("Pkg::CommitResult: ZYpp::commit has failed: %s", excpt.what());
+	_last_error.setLastError(excpt.what());
+	return YCPVoid();
+    }
+
+    return CommitResultHelper(job->result, info);
+}
+
 /*
  Helper function for adding/removing an upgrade repository
 */
@@ -2825,6 +3516,8 @@ YCPValue PkgFunctions::AddRemoveUpgradeRepo(const YCPInteger &repo, bool add)
 	zypp_ptr()->resolver()->removeUpgradeRepo(repository);
     }
 
+    solver_cache.invalidate();
+
     return YCPBoolean(true);
 }
 
@@ -3205,9 +3898,8 @@ PkgFunctions::PkgDU(const YCPString& package)
 	return YCPVoid();
     }
 
-    // get partitioning
-    zypp::DiskUsageCounter ducounter( zypp_ptr()->getPartitions() );
-    return MPS2YCPMap( ducounter.disk_usage( pkg ) );
+    // evaluated only once for the current partitioning
+    return MPS2YCPMap( du_index.solvable( pkg->satSolvable(), zypp_ptr()->getPartitions() ) );
 }
 
 
@@ -3269,7 +3961,7 @@ bool PkgFunctions::CreateBaseProductSymlink()
         zypp::Product::constPtr installed_product = FindInstalledBaseProduct();
         if (!installed_product) return false;
 
-        zypp::sat::Solvable refsolvable = installed_product->referencePackage();
+        zypp::sat::Solvable refsolvable = product_cache.referencePackage(installed_product);
 
 	if (refsolvable != zypp::sat::Solvable::noSolvable)
 	{
@@ -3281,23 +3973,8 @@ bool PkgFunctions::CreateBaseProductSymlink()
 		y2milestone("Found reference package for the base product: %s-%s",
 		    refpkg->name().c_str(), refpkg->edition().asString().c_str());
 
-		// get the package files
-                zypp::Package::FileList files( refpkg->filelist() );
-		y2milestone("The reference package has %d files", files.size());
-
-		std::string product_file;
-		zypp::str::smatch what;
-		const zypp::str::regex product_file_regex("^/etc/products\\.d/(.*\\.prod)$");
-
-		// find the product file
-		for_(iter, files.begin(), files.end())
-		{
-		    if (zypp::str::regex_match(*iter, what, product_file_regex))
-		    {
-			product_file = what[1];
-			break;
-		    }
-		}
+		// find the product file in the package file list
+		std::string product_file(product_cache.productFile(installed_product));
 
 		if (product_file.empty())
 		{
@@ -3381,6 +4058,8 @@ YCPValue PkgFunctions::CreateSolverTestCase(const YCPString &dir)
 
     std::string testcase_dir(dir->value());
     y2milestone("Creating a solver test case in directory %s", testcase_dir.c_str());
+    // the test case runs the solver
+    solver_cache.invalidate();
     bool success = zypp_ptr()->resolver()->createSolverTestcase(testcase_dir);
     y2milestone("Testcase saved: %s", success ? "true" : "false");
 
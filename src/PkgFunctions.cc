@@ -63,11 +63,17 @@ PkgFunctions::PkgFunctions () :
     , _source_loaded(false)
     , zypp_pointer(NULL)
     , repo_manager(NULL)
+    , known_repos_manager(NULL)
+    , known_repos_size(0)
     , autorefresh_skipped(false)
+    , parallel_refresh(0)
     , current_repo(-1LL)
     , commit_policy(NULL)
+    , commit_pipeline(NULL)
     ,_callbackHandler( *new CallbackHandler(*this) )
     , base_product(NULL)
+    , last_cursor_id(0)
+    , last_commit_id(0)
 {
     const char *domain = "pkg-bindings";
     bindtextdomain( domain, LOCALEDIR );
@@ -139,6 +145,8 @@ zypp::ZYpp::Ptr PkgFunctions::zypp_ptr()
  */
 PkgFunctions::~PkgFunctions ()
 {
+    AbortAsyncCommit();
+
     delete &_callbackHandler;
 
     if (base_product)
@@ -244,6 +252,7 @@ zypp::RepoManager* PkgFunctions::CreateRepoManager()
     }
 
     repo_manager = new zypp::RepoManager(repo_manager_options);
+    InvalidateKnownRepos();
     return repo_manager;
 }
 
@@ -488,6 +497,7 @@ bool PkgFunctions::RepoManagerUpdateTarget(const std::string& root, const YCPMap
         // replace the old repository manager
         if (repo_manager) delete repo_manager;
         repo_manager = new_repo_manager;
+        InvalidateKnownRepos();
 
         // remember the repo options for the next time
         repo_options = options;
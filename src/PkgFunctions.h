@@ -29,6 +29,15 @@
 
 #include <string>
 #include <vector>
+#include <map>
+#include <set>
+#include <memory>
+#include <unordered_map>
+#include <chrono>
+#include <mutex>
+
+// pid_t
+#include <sys/types.h>
 
 #include <ycp/YCPMap.h>
 
@@ -44,6 +53,7 @@ class YCPReference;
 #include <zypp/ZYpp.h>
 #include <zypp/Package.h>
 #include <zypp/Product.h>
+#include <zypp/Repository.h>
 
 #include <zypp/DiskUsageCounter.h>
 #include <zypp/RepoManager.h>
@@ -56,6 +66,13 @@ class YCPReference;
 
 #include "ServiceManager.h"
 #include "BaseProduct.h"
+#include "ResolvableAttrs.h"
+#include "DownloadCache.h"
+#include "CommitPipeline.h"
+#include "DiskUsageIndex.h"
+#include "ProductCache.h"
+#include "SelectionSnapshots.h"
+#include "SolverCache.h"
 
 #include "PkgError.h"
 class PkgProgress;
@@ -65,6 +82,11 @@ namespace zypp
     class PoolQuery;
 }
 
+// an open Pkg.ResolvablesOpen() query
+class ResolvableCursor;
+// a running Pkg.AsyncCommit()
+class CommitJob;
+
 /**
  * A simple class for package management access
  */
@@ -117,12 +139,49 @@ class PkgFunctions
       // all known installation sources
       RepoCont repos;
 
+      // alias -> index in 'repos' (only not deleted repositories),
+      // use AddRepo() and MarkRepoDeleted() to keep it in sync
+      mutable std::unordered_map<std::string, RepoId> alias_index;
+
+      // cache: libzypp sat repository -> index in 'repos', see logFindRepo()
+      mutable std::unordered_map<zypp::sat::detail::RepoIdType, RepoId> sat_repo_index;
+
+      // protects the indexes above, the lookups are also done by the commit
+      // callbacks in the AsyncCommit() thread
+      mutable std::recursive_mutex repo_index_mutex;
+
+      typedef std::unordered_map<std::string, zypp::RepoInfo> KnownRepoMap;
+
+      // cache: alias -> repository known by the repo manager (the saved
+      // repositories), rebuilt when the repo manager or the number of its
+      // repositories changes, see KnownRepos()
+      KnownRepoMap known_repos;
+      const zypp::RepoManager *known_repos_manager;
+      zypp::RepoManager::RepoSizeType known_repos_size;
+
+      const KnownRepoMap &KnownRepos();
+      // the repository files have been changed, rebuild the cache
+      void InvalidateKnownRepos();
+
+      // register a new repository, returns the new ID
+      RepoId AddRepo(const YRepo_Ptr &repo);
+      // mark a repository as deleted, the ID stays reserved
+      void MarkRepoDeleted(RepoId id);
+      // forget all repositories
+      void ClearRepos();
+      // rebuild the alias index from scratch
+      void RebuildAliasIndex() const;
+
       // table for converting libzypp source type to Yast type (for backward compatibility)
       std::map<std::string, std::string> type_conversion_table;
 
       // flag for skipping autorefresh
       volatile bool autorefresh_skipped;
 
+      // max. number of repositories refreshed at once in SourceLoad(),
+      // 0 or 1 = refresh sequentially (the default), see SetParallelRefresh()
+      int parallel_refresh;
+
       // flag
       RepoId current_repo;
 
@@ -131,6 +190,19 @@ class PkgFunctions
 
       YCPValue SourceRefreshHelper(const YCPInteger &id, bool forced = false);
       YCPValue ServiceRefreshHelper(const YCPString &alias, bool forced = false);
+      YCPValue ServiceRefreshAllImpl(bool force, PkgProgress &progress);
+
+      // refresh the services in forked worker processes, the services which failed
+      // are not added to 'refreshed', they should be refreshed again,
+      // returns false if the refresh has been aborted by the progress callback
+      bool ParallelServiceRefresh(const std::list<std::string> &services, bool force, int workers,
+	zypp::ProgressData &progress, std::list<std::string> &refreshed);
+      // refresh a service in a worker process, returns the worker exit code
+      int ServiceRefreshWorker(const std::string &alias, bool force);
+
+      // update the loaded repositories after refreshing the services (in one pass),
+      // the new repositories from the refreshed services are added to 'added'
+      void ReconcileServiceRepos(const std::set<std::string> &services, zypp::RepoManager *repomanager, RepoCont &added);
 
       // helper for updating repository manager after changing the target root
       // return true if the target root has been changed
@@ -145,6 +217,22 @@ class PkgFunctions
       // helper - is the network running?
       bool NetworkDetected();
 
+      // the detected network status, cached for a short time
+      // to avoid checking the interfaces for each repository
+      struct NetworkState
+      {
+	  NetworkState() : valid(false), ipv4(false), ipv6(false) {}
+
+	  bool valid;
+	  bool ipv4;
+	  bool ipv6;
+	  std::chrono::steady_clock::time_point checked;
+      };
+
+      NetworkState network_state;
+      // check the network interfaces, use the cached state if force is false
+      const NetworkState &DetectNetwork(bool force = false);
+
       // is the URL remote?
       bool remoteRepo(const zypp::Url &url);
 
@@ -164,9 +252,53 @@ class PkgFunctions
       YCPValue GetPkgLocation(const YCPString& p, bool full_path);
       YCPValue PkgProp(const zypp::PoolItem &item);
       YCPValue PkgMediaSizesOrCount (bool sizes, bool download_size = false);
+
+      // the totals for one medium
+      struct MediaTotal
+      {
+	  MediaTotal() : count(0) {}
+
+	  zypp::ByteCount install_size;
+	  zypp::ByteCount download_size;
+	  long long count;
+      };
+
+      // a package counted in the media totals
+      struct MediaPackage
+      {
+	  RepoId repo;
+	  unsigned int medium;
+	  zypp::ByteCount install_size;
+	  zypp::ByteCount download_size;
+	  // the last update in which the package was still selected
+	  unsigned int generation;
+      };
+
+      // the PkgMediaSizes(), PkgMediaPackageSizes() and PkgMediaCount() totals,
+      // updated incrementally from the changes in the package selection
+      struct MediaSizes
+      {
+	  MediaSizes() : valid(false), pool_serial(0), generation(0) {}
+
+	  bool valid;
+	  // the pool content and the enabled repositories used for the totals,
+	  // a change requires a full recompute
+	  unsigned pool_serial;
+	  std::vector<RepoId> repos;
+
+	  unsigned int generation;
+	  // the selected packages (candidate solvable ID => package)
+	  std::unordered_map<zypp::sat::detail::SolvableIdType, MediaPackage> packages;
+	  // repository => media totals (media are numbered from 1)
+	  std::map<RepoId, std::vector<MediaTotal> > totals;
+      };
+
+      MediaSizes media_sizes;
+      void UpdateMediaSizes();
       YCPValue TargetInitInternal(const YCPString& root, bool rebuild_rpmdb);
 
-      bool aliasExists(const std::string &alias, const std::list<zypp::RepoInfo> &reps) const;
+      // the alias is used by a loaded or a saved repository
+      bool aliasExists(const std::string &alias);
 
       // remember the base product attributes for finding it later in
       // the installed system
@@ -176,6 +308,9 @@ class PkgFunctions
 
       void SetCurrentDU();
 
+      // disk usage of the packages and of the selection, see TargetGetDU()
+      DiskUsageIndex du_index;
+
       // callback related funcions
       void CallSourceReportStart(const std::string &text);
       void CallSourceReportEnd(const std::string &text);
@@ -197,6 +332,16 @@ class PkgFunctions
 	const YCPBoolean &recursive, bool check_signatures);
 
       YCPValue SourceLoadImpl(PkgProgress &progress);
+      // save the changed repositories, written = number of written repositories
+      bool SourceSaveAllImpl(int &written);
+
+      // refresh the repositories in forked worker processes (at most 'workers' at once),
+      // the cache is built as soon as a repository is refreshed,
+      // the repositories which failed are not added to 'refreshed', they should be refreshed again
+      void ParallelAutorefresh(const RepoCont &candidates, zypp::RepoManager *repomanager,
+	zypp::ProgressData &prog_total, RepoCont &refreshed, RepoCont &cache_built, bool &success, int workers);
+      // refresh a repository in a worker process, returns the worker exit code
+      int RefreshWorker(const zypp::RepoInfo &repo, zypp::RepoManager *repomanager);
       YCPValue SourceStartManagerImpl(const YCPBoolean& enable, PkgProgress &progress);
 
       // After all, APPL_HIGH might be more appropriate, because we suggest
@@ -216,11 +361,29 @@ class PkgFunctions
 
       bool CreateBaseProductSymlink();
 
-      YCPMap Resolvable2YCPMap(const zypp::PoolItem &item, bool all, bool deps, const YCPList &attrs);
+      // the parsed product files and the reference packages,
+      // clear it when the target is reloaded
+      ProductCache product_cache;
+
+      // the named states, see SaveNamedState()
+      SelectionSnapshots selection_snapshots;
+
+      // the result of the last PkgSolve() call
+      SolverCache solver_cache;
+
+      // the problems found by the last solver run
+      zypp::ResolverProblemList SolverProblems();
+
+      YCPMap Resolvable2YCPMap(const zypp::PoolItem &item, bool all, bool deps, const ResolvableAttrs &attrs);
 
       // CommitPolicy used for commit
       zypp::ZYppCommitPolicy *commit_policy;
 
+      // the download-ahead pipeline of the running commit (or NULL)
+      CommitPipeline *commit_pipeline;
+      CommitPipeline *CreateCommitPipeline(const CommitPipeline::Settings &settings);
+      YCPMap CommitInfo();
+
       // getPackageFromRepo used for PkgFunctions::ProvidePackage
       zypp::Package::constPtr packageFromRepo(const YCPInteger & repo_id, const YCPString & name);
     private:
@@ -237,7 +400,27 @@ class PkgFunctions
 
       BaseProduct* base_product;
 
-      std::vector<zypp::filesystem::TmpDir> tmp_dirs;
+      // the downloaded signed files and directories
+      DownloadCache download_cache;
+
+      // open ResolvablesOpen() queries (handle => query)
+      std::map<long long, std::shared_ptr<ResolvableCursor> > resolvable_cursors;
+      long long last_cursor_id;
+      // release the queries invalidated by a pool change
+      void CloseStaleResolvableCursors();
+
+      // the running AsyncCommit() (only one at a time)
+      std::shared_ptr<CommitJob> commit_job;
+      long long last_commit_id;
+      std::shared_ptr<CommitJob> FindCommitJob(const YCPInteger &handle);
+      void AbortAsyncCommit();
+
+    public:
+      // only the commit control builtins can be called while an asynchronous
+      // commit is running, returns false and sets the last error otherwise
+      bool CallAllowed(const std::string &builtin);
+
+    private:
 
       YCPMap repo_options;
 
@@ -267,11 +450,15 @@ class PkgFunctions
       {
         Install,
         Remove,
-        Update
+        Update,
+        Neutral,
+        SoftLock
       };
 
       // helper for installing/removing/upgrading a resolvable
       bool ResolvableUpdateInstallOrDelete(const YCPString& name_r, const YCPSymbol& kind_r, ResolvableAction action);
+      // helper for the Resolvables* list variants, returns the failed items
+      YCPValue ResolvablesAction(const YCPList &items, const YCPSymbol &kind_r, ResolvableAction action, bool force);
 
       // it finds the resolvable using attributes saved earlier by RememberBaseProduct
       zypp::Product::constPtr FindInstalledBaseProduct();
@@ -419,6 +606,10 @@ class PkgFunctions
         /* TYPEINFO: void(void()) */
 	YCPValue CallbackFileConflictFinish( const YCPValue& args );
 
+	// callback throttling
+	/* TYPEINFO: boolean(map<string,any>) */
+	YCPValue CallbackThrottle( const YCPMap& config );
+
 	// Script (patch installation) callbacks
 	/* TYPEINFO: void(void(string,string,string,string)) */
 	YCPValue CallbackScriptStart( const YCPValue& /*nil*/ args );
@@ -521,6 +712,8 @@ class PkgFunctions
 	YCPValue SourceGetCurrent (const YCPBoolean& enabled);
 	/* TYPEINFO: boolean()*/
 	YCPValue SourceSaveAll ();
+	/* TYPEINFO: integer()*/
+	YCPValue SourceSaveAllCount ();
 	/* TYPEINFO: boolean()*/
 	YCPValue SourceFinishAll ();
 	/* TYPEINFO: map<string,any>(integer)*/
@@ -545,6 +738,14 @@ class PkgFunctions
 	YCPValue SourceProvideSignedFile(const YCPInteger& id, const YCPInteger& mid, const YCPString& f, const YCPBoolean &optional);
 	/* TYPEINFO: string(integer,integer,string,boolean)*/
 	YCPValue SourceProvideDigestedFile(const YCPInteger& id, const YCPInteger& mid, const YCPString& f, const YCPBoolean &optional);
+	/* TYPEINFO: map<string,string>(integer,integer,list<string>,map<string,any>)*/
+	YCPValue SourceProvideFiles(const YCPInteger& id, const YCPInteger& mid, const YCPList& files, const YCPMap& options);
+	/* TYPEINFO: integer()*/
+	YCPValue SourceDownloadCacheRelease();
+	/* TYPEINFO: integer(list<string>)*/
+	YCPValue SourceDownloadCacheDone(const YCPList &paths);
+	/* TYPEINFO: boolean(integer)*/
+	YCPValue SourceDownloadCacheSetLimit(const YCPInteger &limit);
 	/* TYPEINFO: boolean(string)*/
 	YCPValue SourceCacheCopyTo (const YCPString&);
 	/* TYPEINFO: boolean(integer,boolean)*/
@@ -579,6 +780,8 @@ class PkgFunctions
 	YCPValue RepositoryAdd(const YCPMap &params);
 	/* TYPEINFO: void()*/
 	YCPValue SkipRefresh();
+	/* TYPEINFO: boolean(integer)*/
+	YCPValue SetParallelRefresh(const YCPInteger &workers);
 
 	// target related
 	/* TYPEINFO: boolean(string,boolean)*/
@@ -667,6 +870,16 @@ class PkgFunctions
 	YCPValue SaveState ();
 	/* TYPEINFO: boolean(boolean)*/
 	YCPValue RestoreState (const YCPBoolean&);
+	/* TYPEINFO: boolean(string)*/
+	YCPValue SaveNamedState (const YCPString& name);
+	/* TYPEINFO: integer(string)*/
+	YCPValue RestoreNamedState (const YCPString& name);
+	/* TYPEINFO: boolean(string)*/
+	YCPValue DeleteNamedState (const YCPString& name);
+	/* TYPEINFO: list<string>()*/
+	YCPValue NamedStates ();
+	/* TYPEINFO: map<symbol,list<map<string,any> > >(string,string)*/
+	YCPValue NamedStateDiff (const YCPString& from, const YCPString& to);
 	/* TYPEINFO: map<symbol,integer>(map<string,any>)*/
 	YCPValue PkgUpdateAll (const YCPMap& options);
 	/* TYPEINFO: list<list<any>>(string) */
@@ -696,6 +909,8 @@ class PkgFunctions
 	YCPValue SetAdditionalVendors (const YCPList &args);
 	/* TYPEINFO: boolean(boolean)*/
 	YCPBoolean PkgSolve (const YCPBoolean& filter);
+	/* TYPEINFO: map<string,integer>()*/
+	YCPValue PkgSolveCacheStats ();
 	/* TYPEINFO: boolean(string)*/
 	YCPValue CreateSolverTestCase(const YCPString &dir);
 	/* TYPEINFO: boolean()*/
@@ -708,13 +923,23 @@ class PkgFunctions
 	YCPValue PkgSetSolveSolutions (const YCPList& solutions);
 	/* TYPEINFO: void()*/
 	YCPValue PkgResetSolveSolutions ();
-        YCPValue CommitHelper(const zypp::ZYppCommitPolicy *policy);
+        YCPValue CommitHelper(const zypp::ZYppCommitPolicy *policy, const CommitPipeline::Settings &pipeline_settings);
+        YCPValue CommitResultHelper(const zypp::ZYppCommitResult &commit_result, const YCPMap &commit_info);
+        bool ParseCommitPolicy(const YCPMap &config, zypp::ZYppCommitPolicy &policy, CommitPipeline::Settings &pipeline);
 	/* TYPEINFO: list<any>(integer)*/
 	YCPValue PkgCommit (const YCPInteger& medianr);
 	/* TYPEINFO: list<any>(map<string,any>)*/
 	YCPValue Commit (const YCPMap& config);
 	/* TYPEINFO: map<string,any>()*/
 	YCPValue CommitPolicy();
+	/* TYPEINFO: integer(map<string,any>)*/
+	YCPValue AsyncCommit(const YCPMap& config);
+	/* TYPEINFO: boolean(integer,integer)*/
+	YCPValue CommitPoll(const YCPInteger &handle, const YCPInteger &timeout);
+	/* TYPEINFO: list<any>(integer)*/
+	YCPValue CommitResult(const YCPInteger &handle);
+	/* TYPEINFO: boolean(integer)*/
+	YCPValue CommitAbort(const YCPInteger &handle);
 	/* TYPEINFO: boolean(integer)*/
 	YCPValue AddUpgradeRepo(const YCPInteger &repo);
 	/* TYPEINFO: list<integer>()*/
@@ -771,6 +996,14 @@ class PkgFunctions
         YCPValue ResolvableNeutral( const YCPString& name_r, const YCPSymbol& kind_r, const YCPBoolean& force_r );
 	/* TYPEINFO: boolean(string,symbol)*/
         YCPValue ResolvableSetSoftLock( const YCPString& name_r, const YCPSymbol& kind_r );
+	/* TYPEINFO: list<any>(list<any>,symbol)*/
+        YCPValue ResolvablesInstall( const YCPList& items, const YCPSymbol& kind_r );
+	/* TYPEINFO: list<any>(list<any>,symbol)*/
+        YCPValue ResolvablesRemove( const YCPList& items, const YCPSymbol& kind_r );
+	/* TYPEINFO: list<any>(list<any>,symbol,boolean)*/
+        YCPValue ResolvablesNeutral( const YCPList& items, const YCPSymbol& kind_r, const YCPBoolean& force_r );
+	/* TYPEINFO: list<any>(list<any>,symbol)*/
+        YCPValue ResolvablesSetSoftLock( const YCPList& items, const YCPSymbol& kind_r );
 	/* TYPEINFO: list<map<string,any> >(string,symbol,string)*/
         YCPValue ResolvableProperties(const YCPString& name, const YCPSymbol& kind_r, const YCPString& version);
 	/* TYPEINFO: list<map<string,any> >(string,symbol,string)*/
@@ -786,6 +1019,16 @@ class PkgFunctions
 	YCPValue Resolvables(const YCPMap& filter, const YCPList& attrs);
 	/* TYPEINFO: boolean(map<symbol,any>) */
 	YCPValue AnyResolvable(const YCPMap& filter);
+	/* TYPEINFO: list<any>(list<map<symbol,any> >, symbol) */
+	YCPValue BatchQuery(const YCPList& filters, const YCPSymbol& mode);
+	/* TYPEINFO: integer(map<symbol,any>, list<symbol>) */
+	YCPValue ResolvablesOpen(const YCPMap& filter, const YCPList& attrs);
+	/* TYPEINFO: list<map<string,any> >(integer, integer) */
+	YCPValue ResolvablesNext(const YCPInteger& handle, const YCPInteger& count);
+	/* TYPEINFO: boolean(integer) */
+	YCPValue ResolvablesClose(const YCPInteger& handle);
+	/* TYPEINFO: map<string,list<any> >(map<symbol,any>, list<symbol>) */
+	YCPValue ResolvablesColumns(const YCPMap& filter, const YCPList& attrs);
 
 	// keyring related
 	/* TYPEINFO: boolean(string,boolean)*/
@@ -817,6 +1060,8 @@ class PkgFunctions
 	YCPValue ServiceRefresh(const YCPString&);
 	/* TYPEINFO: boolean(string)*/
 	YCPValue ServiceForceRefresh(const YCPString&);
+	/* TYPEINFO: boolean(boolean)*/
+	YCPValue ServiceRefreshAll(const YCPBoolean &force);
 	/* TYPEINFO: string(string)*/
 	YCPValue ServiceURL(const YCPString &alias);
 	/* TYPEINFO: string(string)*/
@@ -842,12 +1087,22 @@ class PkgFunctions
     /* TYPEINFO: boolean(string) */
     YCPValue UrlSchemeIsDownloading(const YCPString &url_scheme);
 
+	// network related functions
+	/* TYPEINFO: map<string,boolean>(boolean) */
+	YCPValue NetworkStatus(const YCPBoolean &refresh);
+
 	YCPValue ResolvablePropertiesEx(const YCPString& name, const YCPSymbol& kind_r, const YCPString& version, bool all, bool deps, const YCPList &attrs);
 	YCPValue ResolvableSetPatches(const YCPSymbol& kind_r, bool preselect);
 
   /* TYPEINFO: integer(string, string) */
   YCPInteger CompareVersions(const YCPString& ver1, const YCPString& ver2);
 
+	// call statistics
+	/* TYPEINFO: map<string,map<string,integer> >() */
+	YCPValue Stats();
+	/* TYPEINFO: void() */
+	YCPValue StatsReset();
+
 	/**
 	 * Constructor.
 	 */
@@ -860,11 +1115,16 @@ class PkgFunctions
 
 	// must be public, used in callbacks
 	RepoId logFindAlias(const std::string &alias) const;
+	// faster variant for resolvables, avoids creating the RepoInfo object
+	RepoId logFindRepo(const zypp::Repository &repo) const;
 
 	RepoId LastReportedRepo() const;
 	int LastReportedMedium() const;
 	void SetReportedSource(RepoId repo, int medium);
 
+	// the download-ahead pipeline of the running commit (or NULL)
+	CommitPipeline *ActiveCommitPipeline() const { return commit_pipeline; }
+
     string ExpandedName(const string&) const;
     zypp::Url ExpandedUrl(const zypp::Url&) const;
 
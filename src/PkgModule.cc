@@ -21,6 +21,7 @@
 
 
 #include <PkgModule.h>
+#include "PkgStats.h"
 #include "log.h"
 
 #include <zypp/base/Logger.h>
@@ -98,6 +99,9 @@ void PkgModule::destroy()
 {
     if (current_pkg != NULL)
     {
+	if (PkgStats::enabled())
+	    PkgStats::instance().dump();
+
 	y2debug("Deleting PkgModule object...");
 	delete current_pkg;
 	current_pkg = NULL;
@@ -49,15 +49,14 @@ PkgModuleFunctions::~PkgModuleFunctions()
 
 Y2Function* PkgModuleFunctions::createFunctionCall (const string name, constFunctionTypePtr type)
 {
-    vector<string>::iterator it = find (_registered_functions.begin ()
-	, _registered_functions.end (), name);
-    if (it == _registered_functions.end ())
+    std::unordered_map<std::string, unsigned int>::const_iterator it = _function_index.find (name);
+    if (it == _function_index.end ())
     {
 	y2error ("No such function %s", name.c_str ());
 	return NULL;
     }
 
-    return new Y2PkgFunction (name, &pkg_functions, it - _registered_functions.begin ());
+    return new Y2PkgFunction (name, &pkg_functions, it->second);
 }
 
 YCPValue PkgModuleFunctions::evaluate(bool cse)
@@ -69,5 +68,17 @@ YCPValue PkgModuleFunctions::evaluate(bool cse)
 void PkgModuleFunctions::registerFunctions()
 {
 #include "PkgBuiltinTable.h"
+
+    // the generated table only fills the vector, the position in the vector
+    // is the index used in the generated switch in Y2PkgFunction::evaluateCall(),
+    // index the names to avoid scanning the whole table at each call
+    _function_index.reserve (_registered_functions.size ());
+    for (unsigned int i = 0; i < _registered_functions.size (); ++i)
+    {
+	// keep the first occurrence like the previous linear search did
+	_function_index.emplace (_registered_functions[i], i);
+    }
+
+    y2debug ("Registered %zu Pkg builtins", _function_index.size ());
 }
 
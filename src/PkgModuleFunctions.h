@@ -24,6 +24,7 @@
 #define PkgModuleFunctions_h
 
 #include <string>
+#include <unordered_map>
 #include <y2/Y2Namespace.h>
 #include "PkgFunctions.h"
 
@@ -68,5 +69,9 @@ class PkgModuleFunctions : public Y2Namespace
 
 	PkgFunctions pkg_functions;
         std::vector<std::string> _registered_functions;
+
+	// builtin name => position in _registered_functions,
+	// built once in registerFunctions() for a fast lookup
+	std::unordered_map<std::string, unsigned int> _function_index;
 };
 #endif // PkgModuleFunctions_h
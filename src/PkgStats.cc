@@ -0,0 +1,140 @@
+/*
+ * File:   PkgStats.cc
+ *
+ */
+
+#include "PkgStats.h"
+#include "PkgFunctions.h"
+
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include <malloc.h>
+
+#include <ycp/YCPString.h>
+#include <ycp/YCPInteger.h>
+#include <ycp/YCPVoid.h>
+
+#define y2log_component "Pkg"
+#include <y2util/y2log.h>
+
+bool PkgStats::_enabled = getenv("Y2PKG_STATS") != NULL;
+
+namespace
+{
+    long long heap_used()
+    {
+	struct mallinfo2 info = mallinfo2();
+	return info.uordblks + info.hblkhd;
+    }
+}
+
+PkgStats::Call::Call(const std::string &name)
+    : _name(name), _enabled(PkgStats::enabled()), _heap(0)
+{
+    if (!_enabled)
+	return;
+
+    _heap = heap_used();
+    _start = std::chrono::steady_clock::now();
+}
+
+PkgStats::Call::~Call()
+{
+    if (!_enabled)
+	return;
+
+    long long usec = std::chrono::duration_cast<std::chrono::microseconds>(
+	std::chrono::steady_clock::now() - _start).count();
+
+    PkgStats::instance().record(_name, usec, heap_used() - _heap);
+}
+
+PkgStats &PkgStats::instance()
+{
+    static PkgStats stats;
+    return stats;
+}
+
+void PkgStats::record(const std::string &name, long long usec, long long heap_delta)
+{
+    Entry &entry = _stats[name];
+
+    ++entry.count;
+    entry.total_us += usec;
+    entry.heap_delta += heap_delta;
+
+    if (usec > entry.max_us)
+	entry.max_us = usec;
+}
+
+void PkgStats::reset()
+{
+    _stats.clear();
+}
+
+YCPMap PkgStats::toYCP() const
+{
+    YCPMap ret;
+
+    for (std::map<std::string, Entry>::const_iterator it = _stats.begin(); it != _stats.end(); ++it)
+    {
+	YCPMap entry;
+	entry->add(YCPString("count"), YCPInteger(it->second.count));
+	entry->add(YCPString("total_us"), YCPInteger(it->second.total_us));
+	entry->add(YCPString("max_us"), YCPInteger(it->second.max_us));
+	entry->add(YCPString("heap_delta"), YCPInteger(it->second.heap_delta));
+
+	ret->add(YCPString(it->first), entry);
+    }
+
+    return ret;
+}
+
+void PkgStats::dump() const
+{
+    typedef std::pair<std::string, Entry> Item;
+    std::vector<Item> items(_stats.begin(), _stats.end());
+
+    std::sort(items.begin(), items.end(), [](const Item &a, const Item &b)
+	{ return a.second.total_us > b.second.total_us; });
+
+    y2milestone("Pkg builtin statistics (%zd builtins):", items.size());
+
+    for (std::vector<Item>::const_iterator it = items.begin(); it != items.end(); ++it)
+    {
+	y2milestone("  %s: %lld calls, total %lldus, max %lldus, heap %+lld bytes", it->first.c_str(),
+	    it->second.count, it->second.total_us, it->second.max_us, it->second.heap_delta);
+    }
+}
+
+/**
+ * @builtin Stats
+ * @short Return the statistics of the Pkg builtin calls
+ * @description
+ * The statistics are collected only when the Y2PKG_STATS environment variable is set.
+ *
+ * The "heap_delta" value is the net growth of the heap in bytes during the calls,
+ * the memory allocated and released in the call is not included.
+ *
+ * @return map builtin name => $[ "count" : integer, "total_us" : integer,
+ *   "max_us" : integer, "heap_delta" : integer ], the times are in microseconds
+ */
+YCPValue PkgFunctions::Stats()
+{
+    if (!PkgStats::enabled())
+	y2warning("The statistics are disabled, set Y2PKG_STATS environment variable to enable them");
+
+    return PkgStats::instance().toYCP();
+}
+
+/**
+ * @builtin StatsReset
+ * @short Reset the statistics of the Pkg builtin calls
+ * @return void
+ */
+YCPValue PkgFunctions::StatsReset()
+{
+    PkgStats::instance().reset();
+    return YCPVoid();
+}
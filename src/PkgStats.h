@@ -0,0 +1,72 @@
+/*
+ * File:   PkgStats.h
+ *
+ * Per builtin call statistics (number of calls, total and max. time,
+ * heap growth) collected in Y2PkgFunction::evaluateCall().
+ *
+ * The statistics are disabled by default, set the Y2PKG_STATS environment
+ * variable to enable them. When disabled the overhead is a single flag check.
+ */
+
+#ifndef PkgStats_h
+#define PkgStats_h
+
+#include <string>
+#include <map>
+#include <chrono>
+
+#include <ycp/YCPMap.h>
+
+class PkgStats
+{
+  public:
+
+    struct Entry
+    {
+	Entry() : count(0), total_us(0), max_us(0), heap_delta(0) {}
+
+	long long count;
+	long long total_us;
+	long long max_us;
+	// net heap growth in bytes (libycp does not count the allocated objects)
+	long long heap_delta;
+    };
+
+    // measure one builtin call, the result is recorded in the destructor
+    class Call
+    {
+      public:
+	Call(const std::string &name);
+	~Call();
+
+      private:
+	const std::string &_name;
+	bool _enabled;
+	std::chrono::steady_clock::time_point _start;
+	long long _heap;
+    };
+
+    static PkgStats &instance();
+
+    // enabled by the Y2PKG_STATS environment variable
+    static bool enabled() { return _enabled; }
+
+    void record(const std::string &name, long long usec, long long heap_delta);
+    void reset();
+
+    // builtin name => $[ "count" : ..., "total_us" : ..., "max_us" : ..., "heap_delta" : ... ]
+    YCPMap toYCP() const;
+
+    // log the statistics sorted by the total time
+    void dump() const;
+
+  private:
+
+    PkgStats() {}
+
+    static bool _enabled;
+
+    std::map<std::string, Entry> _stats;
+};
+
+#endif // PkgStats_h
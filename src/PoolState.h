@@ -0,0 +1,44 @@
+/*
+ * File:   PoolState.h
+ *
+ * Helpers shared by the caches of the pool data (DiskUsageIndex,
+ * ProductCache, SelectionSnapshots, SolverCache).
+ */
+
+#ifndef PoolState_h
+#define PoolState_h
+
+#include <zypp/ResStatus.h>
+#include <zypp/sat/Pool.h>
+
+// compare the selection relevant parts of the status
+inline bool sameSelectionState(const zypp::ResStatus &a, const zypp::ResStatus &b)
+{
+    return a.getTransactValue() == b.getTransactValue()
+	&& a.getTransactByValue() == b.getTransactByValue()
+	&& a.isLicenceConfirmed() == b.isLicenceConfirmed();
+}
+
+// Detects a change of the pool content, the solvable IDs
+// remembered before the change are not valid anymore.
+class PoolSerial
+{
+  public:
+
+    PoolSerial() : _serial(0), _set(false) {}
+
+    // the pool has been changed since the last update() (or update() has not been called yet)
+    bool changed() const { return !_set || current() != _serial; }
+
+    // remember the current pool content
+    void update() { _serial = current(); _set = true; }
+
+    static unsigned current() { return zypp::sat::Pool::instance().serial().serial(); }
+
+  private:
+
+    unsigned _serial;
+    bool _set;
+};
+
+#endif // PoolState_h
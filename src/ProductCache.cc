@@ -0,0 +1,106 @@
+/*
+ * File:   ProductCache.cc
+ *
+ */
+
+#include "ProductCache.h"
+
+#include <zypp/Package.h>
+#include <zypp/PathInfo.h>
+#include <zypp/base/Regex.h>
+
+#define y2log_component "Pkg"
+#include <y2util/y2log.h>
+
+ProductCache::ProductCache()
+{
+}
+
+void ProductCache::clear()
+{
+    if (!_entries.empty())
+	y2debug("Clearing the product cache (%zd entries)", _entries.size());
+
+    _entries.clear();
+}
+
+ProductCache::Entry &ProductCache::entry(const zypp::Product::constPtr &product)
+{
+    // the solvable IDs are not valid anymore
+    if (_pool.changed())
+    {
+	clear();
+	_pool.update();
+    }
+
+    return _entries[product->satSolvable().id()];
+}
+
+zypp::sat::Solvable ProductCache::referencePackage(const zypp::Product::constPtr &product)
+{
+    Entry &e = entry(product);
+
+    if (!e.reference_found)
+    {
+	e.reference = product->referencePackage();
+	e.reference_found = true;
+    }
+
+    return e.reference;
+}
+
+const std::string &ProductCache::productFile(const zypp::Product::constPtr &product)
+{
+    zypp::sat::Solvable refsolvable = referencePackage(product);
+    Entry &e = entry(product);
+
+    if (e.file_found || refsolvable == zypp::sat::Solvable::noSolvable)
+	return e.file;
+
+    zypp::Package::Ptr refpkg(zypp::make<zypp::Package>(refsolvable));
+
+    if (refpkg)
+    {
+	// get the package files
+	zypp::Package::FileList files( refpkg->filelist() );
+	y2milestone("The reference package has %d files", files.size());
+
+	zypp::str::smatch what;
+	const zypp::str::regex product_file_regex("^/etc/products\\.d/(.*\\.prod)$");
+
+	// find the product file
+	for(const auto &f : files)
+	{
+	    if (zypp::str::regex_match(f, what, product_file_regex))
+	    {
+		e.file = what[1];
+		break;
+	    }
+	}
+    }
+
+    e.file_found = true;
+
+    return e.file;
+}
+
+const zypp::parser::ProductFileData &ProductCache::productFileData(const zypp::Product::constPtr &product,
+    const zypp::Pathname &path)
+{
+    Entry &e = entry(product);
+    zypp::PathInfo info(path);
+
+    if (e.parsed && e.path == path && e.mtime == info.mtime())
+    {
+	y2debug("Using the cached product file %s", path.c_str());
+	return e.data;
+    }
+
+    y2milestone("Parsing product file %s", path.c_str());
+    e.data = zypp::parser::ProductFileReader::scanFile(path);
+    e.path = path;
+    e.mtime = info.mtime();
+    e.parsed = true;
+
+    return e.data;
+}
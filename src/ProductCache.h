@@ -0,0 +1,72 @@
+/*
+ * File:   ProductCache.h
+ *
+ * The product metadata which is expensive to get: the parsed product file
+ * from /etc/products.d (installed products) and the product file name
+ * found in the file list of the reference package.
+ *
+ * The entries are identified by the product solvable, the parsed product
+ * file is read again when its modification time changes. The cache must
+ * be cleared when the target is reloaded or after commit, it is dropped
+ * automatically when the pool content changes.
+ */
+
+#ifndef ProductCache_h
+#define ProductCache_h
+
+#include <string>
+#include <unordered_map>
+
+#include <sys/types.h>
+
+#include <zypp/Pathname.h>
+#include <zypp/Product.h>
+#include <zypp/parser/ProductFileReader.h>
+
+#include "PoolState.h"
+
+class ProductCache
+{
+  public:
+
+    ProductCache();
+
+    void clear();
+
+    // the reference package of the product (noSolvable if not found)
+    zypp::sat::Solvable referencePackage(const zypp::Product::constPtr &product);
+
+    // the product file name (e.g. "SLES.prod") from the file list
+    // of the reference package, empty if not found
+    const std::string &productFile(const zypp::Product::constPtr &product);
+
+    // the parsed product file
+    const zypp::parser::ProductFileData &productFileData(const zypp::Product::constPtr &product,
+	const zypp::Pathname &path);
+
+  private:
+
+    struct Entry
+    {
+	Entry() : reference_found(false), file_found(false), mtime(0), parsed(false) {}
+
+	bool reference_found;
+	zypp::sat::Solvable reference;
+
+	bool file_found;
+	std::string file;
+
+	// the parsed product file
+	zypp::Pathname path;
+	time_t mtime;
+	bool parsed;
+	zypp::parser::ProductFileData data;
+    };
+
+    Entry &entry(const zypp::Product::constPtr &product);
+
+    std::unordered_map<zypp::sat::detail::SolvableIdType, Entry> _entries;
+    PoolSerial _pool;
+};
+
+#endif // ProductCache_h
@@ -0,0 +1,63 @@
+/*
+ * File:   ResolvableAttrs.cc
+ *
+ */
+
+#include "ResolvableAttrs.h"
+
+#include <unordered_map>
+
+#include <ycp/YCPSymbol.h>
+
+#define y2log_component "Pkg"
+#include <y2util/y2log.h>
+
+namespace
+{
+#define ATTR_NAME(N) #N,
+    const char *attr_names[ResolvableAttrs::ATTR_COUNT] = { RESOLVABLE_ATTRIBUTES(ATTR_NAME) };
+#undef ATTR_NAME
+}
+
+ResolvableAttrs::ResolvableAttrs(const YCPList &attrs)
+{
+    if (attrs.isNull())
+	return;
+
+    for (int i = 0; i < attrs->size(); ++i)
+    {
+	YCPValue v = attrs->value(i);
+
+	if (v.isNull() || !v->isSymbol())
+	{
+	    y2warning("Ignoring invalid attribute: %s", v.isNull() ? "nil" : v->toString().c_str());
+	    continue;
+	}
+
+	Attr attr = find(v->asSymbol()->symbol());
+
+	if (attr == ATTR_COUNT)
+	    y2warning("Ignoring unknown attribute: %s", v->asSymbol()->symbol().c_str());
+	else
+	    _attrs.set(attr);
+    }
+}
+
+const char *ResolvableAttrs::name(Attr attr)
+{
+    return (attr < ATTR_COUNT) ? attr_names[attr] : "";
+}
+
+ResolvableAttrs::Attr ResolvableAttrs::find(const std::string &name)
+{
+    static std::unordered_map<std::string, Attr> index;
+
+    if (index.empty())
+    {
+	for (int i = 0; i < ATTR_COUNT; ++i)
+	    index[attr_names[i]] = static_cast<Attr>(i);
+    }
+
+    std::unordered_map<std::string, Attr>::const_iterator it = index.find(name);
+    return (it == index.end()) ? ATTR_COUNT : it->second;
+}
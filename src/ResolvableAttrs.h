@@ -0,0 +1,66 @@
+/*
+ * File:   ResolvableAttrs.h
+ *
+ * The set of resolvable attributes requested in the Pkg.Resolvables()
+ * call. The list of symbols passed from YCP is converted to a bit mask
+ * only once per call so checking whether an attribute is requested
+ * does not need to create a YCPSymbol and scan the list for each
+ * resolvable and each attribute.
+ */
+
+#ifndef ResolvableAttrs_h
+#define ResolvableAttrs_h
+
+#include <bitset>
+#include <string>
+
+#include <ycp/YCPList.h>
+
+// all known attributes, the name is used as the key in the result map
+#define RESOLVABLE_ATTRIBUTES(X) \
+    X(name) X(version) X(version_version) X(version_release) X(version_epoch) \
+    X(arch) X(description) X(summary) X(status) X(transact_by) \
+    X(on_system_by_user) X(locked) X(recommended) X(suggested) X(orphaned) \
+    X(unneeded) X(source) X(license_confirmed) X(license) X(download_size) \
+    X(inst_size) X(medium_nr) X(vendor) X(kind) X(path) X(location) \
+    X(src_type) X(category) X(type) X(relnotes_url) X(display_name) \
+    X(short_name) X(eol) X(update_urls) X(flags) X(extra_urls) \
+    X(optional_urls) X(register_urls) X(smolt_urls) X(relnotes_urls) \
+    X(register_target) X(register_release) X(register_flavor) X(product_line) \
+    X(flavor) X(replaces) X(upgrades) X(product_package) X(product_file) \
+    X(user_visible) X(default) X(icon) X(script) X(order) X(interactive) \
+    X(reboot_needed) X(relogin_needed) X(affects_pkg_manager) X(is_needed) \
+    X(contents) X(dependencies) X(deps)
+
+class ResolvableAttrs
+{
+  public:
+
+#define ATTR_ENUM(N) ATTR_##N,
+    enum Attr { RESOLVABLE_ATTRIBUTES(ATTR_ENUM) ATTR_COUNT };
+#undef ATTR_ENUM
+
+    // no attribute requested
+    ResolvableAttrs() {}
+
+    // convert the list of symbols, unknown symbols are ignored
+    explicit ResolvableAttrs(const YCPList &attrs);
+
+    bool contains(Attr attr) const { return _attrs.test(attr); }
+    bool empty() const { return _attrs.none(); }
+    size_t size() const { return _attrs.count(); }
+
+    void add(Attr attr) { _attrs.set(attr); }
+
+    // the key used in the result map
+    static const char *name(Attr attr);
+
+    // find the attribute by name, returns ATTR_COUNT if not found
+    static Attr find(const std::string &name);
+
+  private:
+
+    std::bitset<ATTR_COUNT> _attrs;
+};
+
+#endif // ResolvableAttrs_h
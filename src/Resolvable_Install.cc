@@ -33,6 +33,46 @@
 #include <ycp/YCPSymbol.h>
 #include <ycp/YCPString.h>
 #include <ycp/YCPInteger.h>
+#include <ycp/YCPList.h>
+#include <ycp/YCPMap.h>
+
+#include <chrono>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <zypp/Repository.h>
+#include <zypp/sat/Pool.h>
+
+namespace
+{
+    // convert the kind symbol, returns false if the kind is not supported
+    bool kind_from_symbol(const std::string &req_kind, zypp::Resolvable::Kind &kind)
+    {
+	if( req_kind == "product" ) {
+	    kind = zypp::ResKind::product;
+	}
+	else if ( req_kind == "patch" ) {
+	    kind = zypp::ResKind::patch;
+	}
+	else if ( req_kind == "package" ) {
+	    kind = zypp::ResKind::package;
+	}
+	else if ( req_kind == "srcpackage" ) {
+	    kind = zypp::ResKind::srcpackage;
+	}
+	else if ( req_kind == "pattern" ) {
+	    kind = zypp::ResKind::pattern;
+	}
+	else
+	{
+	    return false;
+	}
+
+	return true;
+    }
+}
 
 /**
    @builtin ResolvableInstallArchVersion
@@ -65,22 +105,7 @@ PkgFunctions::ResolvableInstallArchVersion( const YCPString& name_r, const YCPSy
     // ensure installation of the required architecture
     zypp::Arch architecture(arch_str);
 
-    if( req_kind == "product" ) {
-	kind = zypp::ResKind::product;
-    }
-    else if ( req_kind == "patch" ) {
-    	kind = zypp::ResKind::patch;
-    }
-    else if ( req_kind == "package" ) {
-	kind = zypp::ResKind::package;
-    }
-    else if ( req_kind == "srcpackage" ) {
-	kind = zypp::ResKind::srcpackage;
-    }
-    else if ( req_kind == "pattern" ) {
-	kind = zypp::ResKind::pattern;
-    }
-    else
+    if (!kind_from_symbol(req_kind, kind))
     {
 	y2error("Pkg::ResolvableInstall: unknown symbol: %s", req_kind.c_str());
 	return YCPBoolean(false);
@@ -124,7 +149,7 @@ PkgFunctions::ResolvableInstallArchVersion( const YCPString& name_r, const YCPSy
 }
 
 // helper function, returns true on success
-bool InstallSelectableFromRepo(zypp::ui::Selectable::Ptr s, const std::string &alias)
+bool InstallSelectableFromRepo(zypp::ui::Selectable::Ptr s, const zypp::Repository &repository)
 {
     bool ret = false;
 
@@ -137,7 +162,7 @@ bool InstallSelectableFromRepo(zypp::ui::Selectable::Ptr s, const std::string &a
 	    zypp::ResObject::constPtr res = *avail_it;
 
 	    // check repository
-	    if (res && res->repoInfo().alias() == alias)
+	    if (res && res->repository() == repository)
 	    {
 		// install the preselected candidate
 		s->setCandidate(res);
@@ -153,7 +178,8 @@ bool InstallSelectableFromRepo(zypp::ui::Selectable::Ptr s, const std::string &a
 /**
    @builtin ResolvableInstallRepo
    @short Install all resolvables with selected name, from the specified repository
-   @param name_r name of the resolvable, if empty ("") install all resolvables of the kind 
+   @param name_r name of the resolvable, if empty ("") install all resolvables of the kind
+   available in the repository
    @param kind_r kind of resolvable, can be `product, `patch, `package, `srcpackage or `pattern
    @param repo_r ID of the repository
    @return boolean false if failed
@@ -165,22 +191,7 @@ PkgFunctions::ResolvableInstallRepo( const YCPString& name_r, const YCPSymbol& k
     
     std::string req_kind = kind_r->symbol ();
 
-    if( req_kind == "product" ) {
-	kind = zypp::ResKind::product;
-    }
-    else if ( req_kind == "patch" ) {
-    	kind = zypp::ResKind::patch;
-    }
-    else if ( req_kind == "package" ) {
-	kind = zypp::ResKind::package;
-    }
-    else if ( req_kind == "srcpackage" ) {
-	kind = zypp::ResKind::srcpackage;
-    }
-    else if ( req_kind == "pattern" ) {
-	kind = zypp::ResKind::pattern;
-    }
-    else
+    if (!kind_from_symbol(req_kind, kind))
     {
 	y2error("Pkg::ResolvableInstallRepo: unknown symbol: %s", req_kind.c_str());
 	return YCPBoolean(false);
@@ -204,22 +215,64 @@ PkgFunctions::ResolvableInstallRepo( const YCPString& name_r, const YCPSymbol& k
     try
     {
 	std::string name(name_r.isNull() ? "" : name_r->value());
+	zypp::Repository repository(zypp::sat::Pool::instance().reposFind(alias));
+
+	if (repository == zypp::Repository::noRepository)
+	{
+	    y2error("Repository %lld (%s) is not loaded", repo_id, alias.c_str());
+	    return YCPBoolean(false);
+	}
 
 	if (name.empty())
 	{
+	    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	    // the selectables with their candidate from the repository, iterating over the repository
+	    // is much faster than checking the candidates of all selectables of the kind
+	    std::vector<std::pair<zypp::ui::Selectable::Ptr, zypp::sat::Solvable> > selectables;
+	    std::unordered_map<zypp::ui::Selectable *, size_t> found;
+
+	    for_(it, repository.solvablesBegin(), repository.solvablesEnd())
+	    {
+		if (!it->isKind(kind))
+		    continue;
+
+		zypp::ui::Selectable::Ptr s = zypp::ui::Selectable::get(*it);
+
+		if (!s)
+		    continue;
+
+		std::unordered_map<zypp::ui::Selectable *, size_t>::iterator idx = found.find(s.get());
+
+		if (idx == found.end())
+		{
+		    found[s.get()] = selectables.size();
+		    selectables.push_back(std::make_pair(s, *it));
+		}
+		// more versions in the repository, use the highest one
+		else if (it->edition() > selectables[idx->second].second.edition())
+		{
+		    selectables[idx->second].second = *it;
+		}
+	    }
+
 	    ret = true;
-	    for (zypp::ResPoolProxy::const_iterator it = zypp_ptr()->poolProxy().byKindBegin(kind);
-		it != zypp_ptr()->poolProxy().byKindEnd(kind);
-		++it)
+	    for_(it, selectables.begin(), selectables.end())
 	    {
-		ret = InstallSelectableFromRepo(*it, alias) && ret;
+		// install the preselected candidate
+		it->first->setCandidate(zypp::PoolItem(it->second));
+		ret = it->first->setToInstall(zypp::ResStatus::APPL_HIGH) && ret;
 	    }
+
+	    y2milestone("Selected %zd %s resolvables from repository %s in %lldms", selectables.size(), req_kind.c_str(),
+		alias.c_str(), (long long)std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now() - start).count());
 	}
 	else
 	{
 	    zypp::ui::Selectable::Ptr s = zypp::ui::Selectable::get(kind, name);
 
-	    ret = InstallSelectableFromRepo(s, alias);
+	    ret = InstallSelectableFromRepo(s, repository);
 
 	    if (!ret)
 	    {
@@ -242,22 +295,7 @@ bool PkgFunctions::ResolvableUpdateInstallOrDelete(const YCPString& name_r, cons
     
     std::string req_kind = kind_r->symbol ();
 
-    if( req_kind == "product" ) {
-	kind = zypp::ResKind::product;
-    }
-    else if ( req_kind == "patch" ) {
-    	kind = zypp::ResKind::patch;
-    }
-    else if ( req_kind == "package" ) {
-	kind = zypp::ResKind::package;
-    }
-    else if ( req_kind == "srcpackage" ) {
-	kind = zypp::ResKind::srcpackage;
-    }
-    else if ( req_kind == "pattern" ) {
-	kind = zypp::ResKind::pattern;
-    }
-    else
+    if (!kind_from_symbol(req_kind, kind))
     {
 	y2error("Unknown symbol: %s", req_kind.c_str());
 	return false;
@@ -409,22 +447,7 @@ PkgFunctions::ResolvableNeutral ( const YCPString& name_r, const YCPSymbol& kind
     std::string name = name_r->value();
     bool force = force_r->value();
 
-    if( req_kind == "product" ) {
-	kind = zypp::ResKind::product;
-    }
-    else if ( req_kind == "patch" ) {
-    	kind = zypp::ResKind::patch;
-    }
-    else if ( req_kind == "package" ) {
-	kind = zypp::ResKind::package;
-    }
-    else if ( req_kind == "srcpackage" ) {
-	kind = zypp::ResKind::srcpackage;
-    }
-    else if ( req_kind == "pattern" ) {
-	kind = zypp::ResKind::pattern;
-    }
-    else
+    if (!kind_from_symbol(req_kind, kind))
     {
 	y2error("Pkg::ResolvableNeutral: unknown symbol: %s", req_kind.c_str());
 	return YCPBoolean(false);
@@ -474,27 +497,16 @@ PkgFunctions::ResolvableSetSoftLock ( const YCPString& name_r, const YCPSymbol&
     std::string req_kind = kind_r->symbol();
     std::string name = name_r->value();
 
-    if( req_kind == "product" ) {
-	kind = zypp::ResKind::product;
-    }
-    else if ( req_kind == "patch" ) {
-    	kind = zypp::ResKind::patch;
-    }
-    else if ( req_kind == "package" ) {
-	kind = zypp::ResKind::package;
-    }
-    else if ( req_kind == "srcpackage" ) {
-	kind = zypp::ResKind::package;
-    }
-    else if ( req_kind == "pattern" ) {
-	kind = zypp::ResKind::pattern;
-    }
-    else
+    if (!kind_from_symbol(req_kind, kind))
     {
 	y2error("Pkg::ResolvableSetSoftLock: unknown symbol: %s", req_kind.c_str());
 	return YCPBoolean(false);
     }
 
+    // `srcpackage locks the package of the same name (the original behavior)
+    if (kind == zypp::ResKind::srcpackage)
+	kind = zypp::ResKind::package;
+
     bool ret = true;
 
     try
@@ -522,3 +534,262 @@ PkgFunctions::ResolvableSetSoftLock ( const YCPString& name_r, const YCPSymbol&
     return YCPBoolean(ret);
 }
 
+
+namespace
+{
+    // name -> selectable for one kind
+    typedef std::unordered_map<std::string, zypp::ui::Selectable::Ptr> SelectableIndex;
+
+    // the index is built by one pass over the selectables of the kind
+    const SelectableIndex &selectable_index(std::map<zypp::Resolvable::Kind, SelectableIndex> &indexes,
+	const zypp::Resolvable::Kind &kind)
+    {
+	std::map<zypp::Resolvable::Kind, SelectableIndex>::iterator found = indexes.find(kind);
+
+	if (found != indexes.end())
+	    return found->second;
+
+	SelectableIndex &index = indexes[kind];
+	zypp::ResPoolProxy proxy(zypp::ResPool::instance().proxy());
+
+	for_(it, proxy.byKindBegin(kind), proxy.byKindEnd(kind))
+	{
+	    index.emplace((*it)->name(), *it);
+	}
+
+	y2debug("Indexed %zd %s selectables", index.size(), kind.c_str());
+
+	return index;
+    }
+
+    std::string map_string(const YCPMap &map, const char *key)
+    {
+	YCPValue value = map->value(YCPString(key));
+	return (!value.isNull() && value->isString()) ? value->asString()->value() : std::string();
+    }
+}
+
+/*
+ Apply the action to all items, an item is either a resolvable name (of kind kind_r)
+ or a map with "name", optional "kind", "arch", "version" and "repo" keys.
+ Returns the items which failed or nil if kind_r is not valid.
+*/
+YCPValue PkgFunctions::ResolvablesAction(const YCPList &items, const YCPSymbol &kind_r, ResolvableAction action, bool force)
+{
+    zypp::Resolvable::Kind default_kind;
+    std::string req_kind = kind_r.isNull() ? "package" : kind_r->symbol();
+
+    if (!kind_from_symbol(req_kind, default_kind))
+    {
+	y2error("Unknown symbol: %s", req_kind.c_str());
+	return YCPVoid();
+    }
+
+    YCPList failed;
+
+    if (items.isNull())
+	return failed;
+
+    std::map<zypp::Resolvable::Kind, SelectableIndex> indexes;
+    int changed = 0;
+
+    try
+    {
+	for (int i = 0; i < items->size(); ++i)
+	{
+	    const YCPValue item(items->value(i));
+
+	    zypp::Resolvable::Kind kind(default_kind);
+	    std::string name, arch, version;
+	    long long repo_id = -1LL;
+
+	    if (item->isString())
+	    {
+		name = item->asString()->value();
+	    }
+	    else if (item->isMap())
+	    {
+		YCPMap m(item->asMap());
+		name = map_string(m, "name");
+		arch = map_string(m, "arch");
+		version = map_string(m, "version");
+
+		YCPValue kind_value(m->value(YCPString("kind")));
+		if (!kind_value.isNull() && (!kind_value->isSymbol()
+		    || !kind_from_symbol(kind_value->asSymbol()->symbol(), kind)))
+		{
+		    y2error("Unknown kind: %s", kind_value->toString().c_str());
+		    failed->add(item);
+		    continue;
+		}
+
+		YCPValue repo_value(m->value(YCPString("repo")));
+		if (!repo_value.isNull() && repo_value->isInteger())
+		    repo_id = repo_value->asInteger()->value();
+	    }
+
+	    if (name.empty())
+	    {
+		y2error("Invalid item: %s", item->toString().c_str());
+		failed->add(item);
+		continue;
+	    }
+
+	    const SelectableIndex &index = selectable_index(indexes, kind);
+	    SelectableIndex::const_iterator found = index.find(name);
+
+	    if (found == index.end())
+	    {
+		y2error("Resolvable %s:%s was not found", kind.c_str(), name.c_str());
+		failed->add(item);
+		continue;
+	    }
+
+	    zypp::ui::Selectable::Ptr s = found->second;
+	    bool ret = false;
+
+	    switch (action)
+	    {
+		case Install:
+		{
+		    if (arch.empty() && version.empty() && repo_id < 0)
+		    {
+			ret = s->setToInstall(whoWantsIt);
+			break;
+		    }
+
+		    std::string alias;
+		    if (repo_id >= 0)
+		    {
+			YRepo_Ptr repo = logFindRepository(repo_id);
+			if (!repo)
+			    break;
+
+			alias = repo->repoInfo().alias();
+		    }
+
+		    const zypp::Arch required_arch(arch);
+		    const zypp::Edition required_version(version);
+
+		    // install the required version, arch and repository
+		    for_(avail_it, s->availableBegin(), s->availableEnd())
+		    {
+			zypp::ResObject::constPtr res = *avail_it;
+
+			if ((arch.empty() || res->arch() == required_arch)
+			    && (version.empty() || res->edition() == required_version)
+			    && (alias.empty() || res->repoInfo().alias() == alias))
+			{
+			    s->setCandidate(*avail_it);
+			    ret = s->setToInstall(whoWantsIt);
+			    break;
+			}
+		    }
+		    break;
+		}
+		case Remove:
+		    ret = s->setToDelete(whoWantsIt);
+		    break;
+		case Neutral:
+		    ret = s->unset(force ? zypp::ResStatus::USER : whoWantsIt);
+		    break;
+		case SoftLock:
+		    ret = s->theObj().status().setSoftLock(whoWantsIt);
+		    break;
+		default:
+		    y2internal("Unsupported resolvable action");
+	    }
+
+	    if (ret)
+	    {
+		++changed;
+	    }
+	    else
+	    {
+		y2warning("Cannot change resolvable %s:%s", kind.c_str(), name.c_str());
+		failed->add(item);
+	    }
+	}
+    }
+    catch (const zypp::Exception &excpt)
+    {
+	y2error("Changing the resolvables failed: %s", excpt.asString().c_str());
+	_last_error.setLastError(ExceptionAsString(excpt));
+	return YCPVoid();
+    }
+
+    y2milestone("Changed %d resolvables, failed: %d", changed, failed->size());
+
+    return failed;
+}
+
+/**
+   @builtin ResolvablesInstall
+   @short Install all resolvables from the list
+   @description
+   The same as calling Pkg::ResolvableInstall() for each item but much faster for long lists.
+   An item is either a resolvable name or a map with the "name" key and optional
+   "kind" (symbol), "arch", "version" (strings) and "repo" (integer, repository ID) keys
+   selecting the version to install. An item with an invalid "kind" value fails.
+
+   <code>
+   Pkg::ResolvablesInstall(["yast2", $["name" : "kernel-default", "arch" : "x86_64", "repo" : 1]], `package);
+   </code>
+   @param items list of names or maps
+   @param kind_r the default kind for the items, can be `product, `patch, `package, `srcpackage or `pattern
+   @return list the items which could not be selected (empty list = success), nil if kind_r is invalid
+*/
+YCPValue
+PkgFunctions::ResolvablesInstall(const YCPList& items, const YCPSymbol& kind_r)
+{
+    return ResolvablesAction(items, kind_r, Install, false);
+}
+
+/**
+   @builtin ResolvablesRemove
+   @short Remove all resolvables from the list
+   @description
+   The same as calling Pkg::ResolvableRemove() for each item, see Pkg::ResolvablesInstall()
+   for the items format (only "name" and "kind" keys are used).
+   @param items list of names or maps
+   @param kind_r the default kind for the items, can be `product, `patch, `package, `srcpackage or `pattern
+   @return list the items which could not be selected (empty list = success), nil if kind_r is invalid
+*/
+YCPValue
+PkgFunctions::ResolvablesRemove(const YCPList& items, const YCPSymbol& kind_r)
+{
+    return ResolvablesAction(items, kind_r, Remove, false);
+}
+
+/**
+   @builtin ResolvablesNeutral
+   @short Remove the transactions from all resolvables from the list
+   @description
+   The same as calling Pkg::ResolvableNeutral() for each item, see Pkg::ResolvablesInstall()
+   for the items format (only "name" and "kind" keys are used).
+   @param items list of names or maps
+   @param kind_r the default kind for the items, can be `product, `patch, `package, `srcpackage or `pattern
+   @param force_r remove the transactions even on USER level (use true value only if really needed!)
+   @return list the items which could not be changed (empty list = success), nil if kind_r is invalid
+*/
+YCPValue
+PkgFunctions::ResolvablesNeutral(const YCPList& items, const YCPSymbol& kind_r, const YCPBoolean& force_r)
+{
+    return ResolvablesAction(items, kind_r, Neutral, !force_r.isNull() && force_r->value());
+}
+
+/**
+   @builtin ResolvablesSetSoftLock
+   @short Soft lock all resolvables from the list
+   @description
+   The same as calling Pkg::ResolvableSetSoftLock() for each item, see Pkg::ResolvablesInstall()
+   for the items format (only "name" and "kind" keys are used).
+   @param items list of names or maps
+   @param kind_r the default kind for the items, can be `product, `patch, `package, `srcpackage or `pattern
+   @return list the items which could not be locked (empty list = success), nil if kind_r is invalid
+*/
+YCPValue
+PkgFunctions::ResolvablesSetSoftLock(const YCPList& items, const YCPSymbol& kind_r)
+{
+    return ResolvablesAction(items, kind_r, SoftLock, false);
+}
@@ -30,6 +30,10 @@
 #include "ycpTools.h"
 
 #include <set>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <unordered_map>
 
 #include <ycp/YCPBoolean.h>
 #include <ycp/YCPInteger.h>
@@ -49,7 +53,7 @@
 #include <zypp/Dep.h>
 #include <zypp/sat/LocaleSupport.h>
 #include <zypp/parser/ProductFileReader.h>
-#include <zypp/base/Regex.h>
+#include <zypp/base/SerialNumber.h>
 #include <zypp/PoolQuery.h>
 
 /**
@@ -215,38 +219,43 @@ std::string PkgFunctions::TransactToString(zypp::ResStatus::TransactByValue tran
     return ret;
 }
 
-YCPMap PkgFunctions::Resolvable2YCPMap(const zypp::PoolItem &item, bool all, bool deps, const YCPList &attrs)
+YCPMap PkgFunctions::Resolvable2YCPMap(const zypp::PoolItem &item, bool all, bool deps, const ResolvableAttrs &attrs)
 {
     YCPMap info;
 
 // define some helper macros
+#define REQUESTED(K) attrs.contains(ResolvableAttrs::ATTR_##K)
 #define ADD_STRING(K, V) \
-	if (all || attrs->contains(YCPSymbol(K))) \
-		info->add(YCPString(K), YCPString(V));
+	if (all || REQUESTED(K)) \
+		info->add(YCPString(#K), YCPString(V));
 #define ADD_BOOLEAN(K, V) \
-	if (all || attrs->contains(YCPSymbol(K))) \
-		info->add(YCPString(K), YCPBoolean(V));
+	if (all || REQUESTED(K)) \
+		info->add(YCPString(#K), YCPBoolean(V));
 #define ADD_INTEGER(K, V) \
-	if (all || attrs->contains(YCPSymbol(K))) \
-		info->add(YCPString(K), YCPInteger(V));
+	if (all || REQUESTED(K)) \
+		info->add(YCPString(#K), YCPInteger(V));
 #define ADD_SYMBOL(K, V) \
-	if (all || attrs->contains(YCPSymbol(K))) \
-		info->add(YCPString(K), YCPSymbol(V));
+	if (all || REQUESTED(K)) \
+		info->add(YCPString(#K), YCPSymbol(V));
 #define ADD_NOT_EMPTY_LIST(K, V) \
-		if ((all && !(V).isEmpty()) || attrs->contains(YCPSymbol(K))) \
-			info->add(YCPString(K), V);
+	if (all || REQUESTED(K)) \
+	{ \
+		YCPList list_value(V); \
+		if ((all && !list_value.isEmpty()) || REQUESTED(K)) \
+			info->add(YCPString(#K), list_value); \
+	}
 #define ADD_NOT_EMPTY_STRING(K, V) \
-		if ((all && !(V).empty()) || attrs->contains(YCPSymbol(K))) \
-			info->add(YCPString(K), YCPString(V));
+		if ((all && !(V).empty()) || REQUESTED(K)) \
+			info->add(YCPString(#K), YCPString(V));
 
-	ADD_STRING("name", item->name());
+	ADD_STRING(name, item->name());
     // complete edition: [epoch:]version[-release]
-	ADD_STRING("version", item->edition().asString());
-	ADD_STRING("version_version", item->edition().version());
-	ADD_STRING("version_release", item->edition().release());
+	ADD_STRING(version, item->edition().asString());
+	ADD_STRING(version_version, item->edition().version());
+	ADD_STRING(version_release, item->edition().release());
 
     // parts of the edition
-	if (all || attrs->contains(YCPSymbol("version_epoch")))
+	if (all || REQUESTED(version_epoch))
 	{
 		if (item->edition().epoch() == zypp::Edition::noepoch)
 			info->add(YCPString("version_epoch"), YCPVoid());
@@ -254,16 +263,19 @@ YCPMap PkgFunctions::Resolvable2YCPMap(const zypp::PoolItem &item, bool all, boo
 			info->add(YCPString("version_epoch"), YCPInteger(item->edition().epoch()));
 	}
 
-	ADD_STRING("arch", item->arch().asString());
-	ADD_STRING("description", item->description());
+	ADD_STRING(arch, item->arch().asString());
+	ADD_STRING(description, item->description());
 
-    std::string resolvable_summary = item->summary();
-	ADD_NOT_EMPTY_STRING("summary", resolvable_summary);
+	if (all || REQUESTED(summary))
+	{
+		std::string resolvable_summary = item->summary();
+		ADD_NOT_EMPTY_STRING(summary, resolvable_summary);
+	}
 
     zypp::ResStatus status = item.status();
 
     // status
-	if (all || attrs->contains(YCPSymbol("status")))
+	if (all || REQUESTED(status))
 	{
 		std::string stat;
 
@@ -277,96 +289,116 @@ YCPMap PkgFunctions::Resolvable2YCPMap(const zypp::PoolItem &item, bool all, boo
 	    info->add(YCPString("status"), YCPSymbol(stat));
 	}
 
-	ADD_SYMBOL("transact_by", TransactToString(status.getTransactByValue()));
-	ADD_BOOLEAN("on_system_by_user", item.satSolvable().onSystemByUser());
+	ADD_SYMBOL(transact_by, TransactToString(status.getTransactByValue()));
+	ADD_BOOLEAN(on_system_by_user, item.satSolvable().onSystemByUser());
     // is the resolvable locked? (Locked or Taboo in the UI)
-	ADD_BOOLEAN("locked", status.isLocked());
+	ADD_BOOLEAN(locked, status.isLocked());
 
 	// additional status flags
-	ADD_BOOLEAN("recommended", status.isRecommended());
-	ADD_BOOLEAN("suggested", status.isSuggested());
-	ADD_BOOLEAN("orphaned", status.isOrphaned());
-	ADD_BOOLEAN("unneeded", status.isUnneeded());
+	ADD_BOOLEAN(recommended, status.isRecommended());
+	ADD_BOOLEAN(suggested, status.isSuggested());
+	ADD_BOOLEAN(orphaned, status.isOrphaned());
+	ADD_BOOLEAN(unneeded, status.isUnneeded());
 
     // source
-	ADD_INTEGER("source", logFindAlias(item->repoInfo().alias()));
+	ADD_INTEGER(source, logFindRepo(item.satSolvable().repository()));
 
     // add license info if it is defined
-    std::string license = item->licenseToConfirm();
-    if ((all && !license.empty()) || attrs->contains(YCPSymbol("license_confirmed")))
-	{
-		info->add(YCPString("license_confirmed"), YCPBoolean(item.status().isLicenceConfirmed()));
-	}
-    if ((all && !license.empty()) || attrs->contains(YCPSymbol("license")))
+	if (all || REQUESTED(license_confirmed) || REQUESTED(license))
 	{
-		info->add(YCPString("license"), YCPString(license));
+		std::string license = item->licenseToConfirm();
+		if ((all && !license.empty()) || REQUESTED(license_confirmed))
+		{
+			info->add(YCPString("license_confirmed"), YCPBoolean(item.status().isLicenceConfirmed()));
+		}
+		if ((all && !license.empty()) || REQUESTED(license))
+		{
+			info->add(YCPString("license"), YCPString(license));
+		}
 	}
 
-	ADD_INTEGER("download_size", item->downloadSize());
-	ADD_INTEGER("inst_size", item->installSize());
-	ADD_INTEGER("medium_nr", item->mediaNr());
-	ADD_STRING("vendor", item->vendor());
+	ADD_INTEGER(download_size, item->downloadSize());
+	ADD_INTEGER(inst_size, item->installSize());
+	ADD_INTEGER(medium_nr, item->mediaNr());
+	ADD_STRING(vendor, item->vendor());
 
     // package specific info
 	zypp::Package::constPtr pkg = zypp::asKind<zypp::Package>(item.resolvable());
 	if (pkg)
 	{
-		ADD_SYMBOL("kind", "package");
+		ADD_SYMBOL(kind, "package");
+
+		if (all || REQUESTED(path) || REQUESTED(location))
+		{
+			const zypp::Pathname &filename = pkg->location().filename();
 
-		std::string path = pkg->location().filename().asString();
-		ADD_NOT_EMPTY_STRING("path", path);
+			std::string path = filename.asString();
+			ADD_NOT_EMPTY_STRING(path, path);
 
-		std::string location = pkg->location().filename().basename();
-		ADD_NOT_EMPTY_STRING("location", location);
+			std::string location = filename.basename();
+			ADD_NOT_EMPTY_STRING(location, location);
+		}
 	}
 
 	zypp::SrcPackage::constPtr src_pkg = zypp::asKind<zypp::SrcPackage>(item.resolvable());
 	if (src_pkg)
 	{
-		ADD_SYMBOL("kind", "srcpackage");
+		ADD_SYMBOL(kind, "srcpackage");
 
-		std::string path = src_pkg->location().filename().asString();
-		ADD_NOT_EMPTY_STRING("path", path);
+		if (all || REQUESTED(path) || REQUESTED(location))
+		{
+			const zypp::Pathname &filename = src_pkg->location().filename();
+
+			std::string path = filename.asString();
+			ADD_NOT_EMPTY_STRING(path, path);
 
-		std::string location = src_pkg->location().filename().basename();
-		ADD_NOT_EMPTY_STRING("location", location);
+			std::string location = filename.basename();
+			ADD_NOT_EMPTY_STRING(location, location);
+		}
 
-		ADD_STRING("src_type", src_pkg->sourcePkgType());
+		ADD_STRING(src_type, src_pkg->sourcePkgType());
 	}
 
 	zypp::Product::constPtr product = zypp::asKind<zypp::Product>(item.resolvable());
 	if ( product )
 	{
-		ADD_SYMBOL("kind", "product");
+		ADD_SYMBOL(kind, "product");
 
-		std::string category(product->isTargetDistribution() ? "base" : "addon");
+		if (all || REQUESTED(category) || REQUESTED(type))
+		{
+			std::string category(product->isTargetDistribution() ? "base" : "addon");
 
-		ADD_STRING("category", category);
-		ADD_STRING("type", category);
-		ADD_STRING("relnotes_url", product->releaseNotesUrls().first().asString());
+			ADD_STRING(category, category);
+			ADD_STRING(type, category);
+		}
 
-		std::string product_summary = product->summary();
-		ADD_STRING("display_name", product_summary);
+		ADD_STRING(relnotes_url, product->releaseNotesUrls().first().asString());
 
-		if (all || attrs->contains(YCPSymbol("short_name")))
+		if (all || REQUESTED(display_name) || REQUESTED(short_name))
 		{
-			std::string product_shortname = product->shortName();
-			ADD_NOT_EMPTY_STRING("short_name", product_shortname)
-			else if (!product_summary.empty())
-				// use summary for the short name if it's defined
-				info->add(YCPString("short_name"), YCPString(product_summary));
+			std::string product_summary = product->summary();
+			ADD_STRING(display_name, product_summary);
+
+			if (all || REQUESTED(short_name))
+			{
+				std::string product_shortname = product->shortName();
+				ADD_NOT_EMPTY_STRING(short_name, product_shortname)
+				else if (!product_summary.empty())
+					// use summary for the short name if it's defined
+					info->add(YCPString("short_name"), YCPString(product_summary));
+			}
 		}
 
-		if ((all && product->endOfLife() > 0) || attrs->contains(YCPSymbol("eol")))
+		if ((all && product->endOfLife() > 0) || REQUESTED(eol))
           info->add(YCPString("eol"), YCPInteger(product->endOfLife()));
 
-		if (all || attrs->contains(YCPSymbol("update_urls")))
+		if (all || REQUESTED(update_urls))
 		{
 			YCPList updateUrls(asYCPList(product->updateUrls()));
 			info->add(YCPString("update_urls"), updateUrls);
 		}
 
-		if (all || attrs->contains(YCPSymbol("flags")))
+		if (all || REQUESTED(flags))
 		{
 			YCPList flags;
 
@@ -376,73 +408,66 @@ YCPMap PkgFunctions::Resolvable2YCPMap(const zypp::PoolItem &item, bool all, boo
 			info->add(YCPString("flags"), flags);
 		}
 
-		YCPList extraUrls( asYCPList(product->extraUrls()) );
-		ADD_NOT_EMPTY_LIST("extra_urls", extraUrls);
-
-		YCPList optionalUrls( asYCPList(product->optionalUrls()) );
-		ADD_NOT_EMPTY_LIST("optional_urls", optionalUrls);
-
-		YCPList registerUrls( asYCPList(product->registerUrls()) );
-		ADD_NOT_EMPTY_LIST("register_urls", registerUrls);
-
-		YCPList smoltUrls( asYCPList(product->smoltUrls()));
-		ADD_NOT_EMPTY_LIST("smolt_urls", smoltUrls);
-
-		YCPList relNotesUrls(asYCPList(product->releaseNotesUrls()));
-		ADD_NOT_EMPTY_LIST("relnotes_urls", relNotesUrls);
+		ADD_NOT_EMPTY_LIST(extra_urls, asYCPList(product->extraUrls()));
+		ADD_NOT_EMPTY_LIST(optional_urls, asYCPList(product->optionalUrls()));
+		ADD_NOT_EMPTY_LIST(register_urls, asYCPList(product->registerUrls()));
+		ADD_NOT_EMPTY_LIST(smolt_urls, asYCPList(product->smoltUrls()));
+		ADD_NOT_EMPTY_LIST(relnotes_urls, asYCPList(product->releaseNotesUrls()));
 
 		// registration data
-		ADD_STRING("register_target", product->registerTarget());
-		ADD_STRING("register_release", product->registerRelease());
-		ADD_STRING("register_flavor", product->registerFlavor());
-		ADD_STRING("product_line", product->productLine());
+		ADD_STRING(register_target, product->registerTarget());
+		ADD_STRING(register_release, product->registerRelease());
+		ADD_STRING(register_flavor, product->registerFlavor());
+		ADD_STRING(product_line, product->productLine());
 		// Live CD, FTP Edition...
-		ADD_STRING("flavor", product->flavor());
+		ADD_STRING(flavor, product->flavor());
 
 		// get the installed Products it would replace.
-		zypp::Product::ReplacedProducts replaced(product->replacedProducts());
-		if ((all && !replaced.empty()) || attrs->contains(YCPSymbol("replaces")))
+		if (all || REQUESTED(replaces))
 		{
-			YCPList rep_prods;
-
-			// add the products to the list
-			for (auto const &replacedProduct : replaced)
+			zypp::Product::ReplacedProducts replaced(product->replacedProducts());
+			if ((all && !replaced.empty()) || REQUESTED(replaces))
 			{
-				if (!replacedProduct) continue;
-
-				YCPMap rprod;
-				rprod->add(YCPString("name"), YCPString(replacedProduct->name()));
-				rprod->add(YCPString("version"), YCPString(replacedProduct->edition().asString()));
-				rprod->add(YCPString("arch"), YCPString(replacedProduct->arch().asString()));
-				rprod->add(YCPString("description"), YCPString(replacedProduct->description()));
-
-				std::string product_summary = replacedProduct->summary();
-				if (!product_summary.empty())
-					rprod->add(YCPString("display_name"), YCPString(product_summary));
-
-				std::string product_shortname = replacedProduct->shortName();
-				if (!product_shortname.empty())
-					rprod->add(YCPString("short_name"), YCPString(product_shortname));
-				// use summary for the short name if it's defined
-				else if (!product_summary.empty())
-					rprod->add(YCPString("short_name"), YCPString(product_summary));
+				YCPList rep_prods;
 
-				rep_prods->add(rprod);
-			}
+				// add the products to the list
+				for (auto const &replacedProduct : replaced)
+				{
+					if (!replacedProduct) continue;
+
+					YCPMap rprod;
+					rprod->add(YCPString("name"), YCPString(replacedProduct->name()));
+					rprod->add(YCPString("version"), YCPString(replacedProduct->edition().asString()));
+					rprod->add(YCPString("arch"), YCPString(replacedProduct->arch().asString()));
+					rprod->add(YCPString("description"), YCPString(replacedProduct->description()));
+
+					std::string product_summary = replacedProduct->summary();
+					if (!product_summary.empty())
+						rprod->add(YCPString("display_name"), YCPString(product_summary));
+
+					std::string product_shortname = replacedProduct->shortName();
+					if (!product_shortname.empty())
+						rprod->add(YCPString("short_name"), YCPString(product_shortname));
+					// use summary for the short name if it's defined
+					else if (!product_summary.empty())
+						rprod->add(YCPString("short_name"), YCPString(product_summary));
+
+					rep_prods->add(rprod);
+				}
 
-			info->add(YCPString("replaces"), rep_prods);
+				info->add(YCPString("replaces"), rep_prods);
+			}
 		}
 
 		std::string product_file;
 
 		// add reference file in /etc/products.d
-		if (all || attrs->contains(YCPSymbol("upgrades")))
+		if (all || REQUESTED(upgrades))
 		{
 			if (status.isInstalled())
 			{
 				product_file = (_target_root + "/etc/products.d/" + product->referenceFilename()).asString();
-				y2milestone("Parsing product file %s", product_file.c_str());
-				const zypp::parser::ProductFileData productFileData = zypp::parser::ProductFileReader::scanFile(product_file);
+				const zypp::parser::ProductFileData &productFileData = product_cache.productFileData(product, product_file);
 
 				YCPList upgrade_list;
 
@@ -461,22 +486,22 @@ YCPMap PkgFunctions::Resolvable2YCPMap(const zypp::PoolItem &item, bool all, boo
 
 				info->add(YCPString("upgrades"), upgrade_list);
 			}
-			else if (attrs->contains(YCPSymbol("upgrades")))
+			else if (REQUESTED(upgrades))
 			{
 				info->add(YCPString("upgrades"), YCPVoid());
 			}
 		}
 
-		if (all || attrs->contains(YCPSymbol("product_package")))
+		if (all || REQUESTED(product_package))
 		{
 			// pre-set the default value (nil) if the attribute is requested
-			if (attrs->contains(YCPSymbol("product_package")))
+			if (REQUESTED(product_package))
 			{
 				info->add(YCPString("product_package"), YCPVoid());
 			}
 
 			// get the package
-			zypp::sat::Solvable refsolvable = product->referencePackage();
+			zypp::sat::Solvable refsolvable = product_cache.referencePackage(product);
 
 			if (refsolvable != zypp::sat::Solvable::noSolvable)
 			{
@@ -485,32 +510,25 @@ YCPMap PkgFunctions::Resolvable2YCPMap(const zypp::PoolItem &item, bool all, boo
 
 				if (refpkg)
 				{
-					ADD_STRING("product_package", refpkg->name());
-
-					// get the package files
-					zypp::Package::FileList files( refpkg->filelist() );
-					y2milestone("The reference package has %d files", files.size());
+					ADD_STRING(product_package, refpkg->name());
 
-					zypp::str::smatch what;
-					const zypp::str::regex product_file_regex("^/etc/products\\.d/(.*\\.prod)$");
-
-					// find the product file
-					for(const auto &f : files)
+					// the file list is only needed for finding the product file,
+					// reading it is expensive, skip it if the product file is not requested
+					if (all || REQUESTED(product_file))
 					{
-						if (zypp::str::regex_match(f, what, product_file_regex))
-						{
-							product_file = what[1];
-							break;
-						}
+						// the file list is read only once
+						const std::string &file = product_cache.productFile(product);
+						if (!file.empty())
+							product_file = file;
 					}
 				}
 	    }
 		}
 
-		if (all || attrs->contains(YCPSymbol("path")))
+		if (all || REQUESTED(path))
 		{
 			// get the reference package
-			zypp::sat::Solvable refsolvable = product->referencePackage();
+			zypp::sat::Solvable refsolvable = product_cache.referencePackage(product);
 
 			if (refsolvable != zypp::sat::Solvable::noSolvable)
 			{
@@ -519,50 +537,50 @@ YCPMap PkgFunctions::Resolvable2YCPMap(const zypp::PoolItem &item, bool all, boo
 
 				if (refpkg)
 				{
-					ADD_STRING("path", refpkg->location().filename().asString());
+					ADD_STRING(path, refpkg->location().filename().asString());
 				}
 			}
 		}
 
-		if (all || attrs->contains(YCPSymbol("product_file")))
+		if (all || REQUESTED(product_file))
 		{
 			if (product_file.empty())
 				y2warning("The product file has not been found");
 			else
 				y2milestone("Found product file %s", product_file.c_str());
 
-			ADD_NOT_EMPTY_STRING("product_file", product_file);
+			ADD_NOT_EMPTY_STRING(product_file, product_file);
 		}
 	}
 
     // pattern specific info
 	zypp::Pattern::constPtr pattern = zypp::asKind<zypp::Pattern>(item.resolvable());
     if (pattern) {
-		ADD_SYMBOL("kind", "pattern");
+		ADD_SYMBOL(kind, "pattern");
 
-		ADD_STRING("category", pattern->category());
-		ADD_BOOLEAN("user_visible", pattern->userVisible());
+		ADD_STRING(category, pattern->category());
+		ADD_BOOLEAN(user_visible, pattern->userVisible());
 
-		ADD_BOOLEAN("default", pattern->isDefault());
-		ADD_STRING("icon", pattern->icon().asString());
-		ADD_STRING("script", pattern->script().asString());
-		ADD_STRING("order", pattern->order());
+		ADD_BOOLEAN(default, pattern->isDefault());
+		ADD_STRING(icon, pattern->icon().asString());
+		ADD_STRING(script, pattern->script().asString());
+		ADD_STRING(order, pattern->order());
     }
 
     // patch specific info
 	zypp::Patch::constPtr patch_ptr = zypp::asKind<zypp::Patch>(item.resolvable());
 	if (patch_ptr)
 	{
-		ADD_SYMBOL("kind", "patch");
+		ADD_SYMBOL(kind, "patch");
 
-		ADD_BOOLEAN("interactive", patch_ptr->interactive());
-		ADD_BOOLEAN("reboot_needed", patch_ptr->rebootSuggested());
-		ADD_BOOLEAN("relogin_needed", patch_ptr->reloginSuggested());
-		ADD_BOOLEAN("affects_pkg_manager", patch_ptr->restartSuggested());
-		ADD_BOOLEAN("is_needed", item.isBroken());
+		ADD_BOOLEAN(interactive, patch_ptr->interactive());
+		ADD_BOOLEAN(reboot_needed, patch_ptr->rebootSuggested());
+		ADD_BOOLEAN(relogin_needed, patch_ptr->reloginSuggested());
+		ADD_BOOLEAN(affects_pkg_manager, patch_ptr->restartSuggested());
+		ADD_BOOLEAN(is_needed, item.isBroken());
 
         // names and versions of packages, contained in the patch
-		if (all || attrs->contains(YCPSymbol("contents")))
+		if (all || REQUESTED(contents))
 		{
 			YCPMap contents;
 			for (const auto &res : patch_ptr->contents())
@@ -572,7 +590,7 @@ YCPMap PkgFunctions::Resolvable2YCPMap(const zypp::PoolItem &item, bool all, boo
     }
 
     // dependency info
-    if (deps || attrs->contains(YCPSymbol("dependencies")) || attrs->contains(YCPSymbol("deps")))
+    if (deps || REQUESTED(dependencies) || REQUESTED(deps))
     {
 		std::set<std::string> _kinds = {
 			"provides", "prerequires", "requires", "conflicts", "obsoletes",
@@ -614,13 +632,21 @@ YCPMap PkgFunctions::Resolvable2YCPMap(const zypp::PoolItem &item, bool all, boo
             }
 		}
 
-		if (ycpdeps.size() > 0 || attrs->contains(YCPSymbol("dependencies")))
+		if (ycpdeps.size() > 0 || REQUESTED(dependencies))
 			info->add (YCPString ("dependencies"), ycpdeps);
 
-		if (rawdeps.size() > 0 || attrs->contains(YCPSymbol("deps")))
+		if (rawdeps.size() > 0 || REQUESTED(deps))
 			info->add (YCPString ("deps"), rawdeps);
     }
 
+#undef ADD_NOT_EMPTY_STRING
+#undef ADD_NOT_EMPTY_LIST
+#undef ADD_SYMBOL
+#undef ADD_INTEGER
+#undef ADD_BOOLEAN
+#undef ADD_STRING
+#undef REQUESTED
+
     return info;
 }
 
@@ -633,6 +659,9 @@ PkgFunctions::ResolvablePropertiesEx(const YCPString& name, const YCPSymbol& kin
     std::string vers = version->value();
     YCPList ret;
 
+    // convert the attribute list only once
+    ResolvableAttrs requested(attrs);
+
     if( req_kind == "product" ) {
     	kind = zypp::ResKind::product;
     }
@@ -703,7 +732,7 @@ PkgFunctions::ResolvablePropertiesEx(const YCPString& name, const YCPSymbol& kin
                             // check version if required
                             if (vers.empty() || vers == inst_it->resolvable()->edition().asString())
                             {
-                                ret->add(Resolvable2YCPMap(*inst_it, all_attrs, deps, attrs));
+                                ret->add(Resolvable2YCPMap(*inst_it, all_attrs, deps, requested));
                             }
                         }
                     }
@@ -716,7 +745,7 @@ PkgFunctions::ResolvablePropertiesEx(const YCPString& name, const YCPSymbol& kin
                             // check version if required
                             if (vers.empty() || vers == avail_it->resolvable()->edition().asString())
                             {
-                                ret->add(Resolvable2YCPMap(*avail_it, all_attrs, deps, attrs));
+                                ret->add(Resolvable2YCPMap(*avail_it, all_attrs, deps, requested));
                             }
                         }
                     }
@@ -850,14 +879,7 @@ struct ResolvableFilter
 		check_locked(false), check_recommended(false), check_suggested(false),
 		check_orphaned(false), check_unneeded(false),
 		check_on_system(false), check_license_confirmed(false),	medium_nr(-1),
-		check_provides(false), check_regexp_provides(false),
-		check_obsoletes(false), check_regexp_obsoletes(false),
-		check_conflicts(false), check_regexp_conflicts(false),
-		check_requires(false), check_regexp_requires(false),
-		check_recommends(false), check_regexp_recommends(false),
-		check_suggests(false), check_regexp_suggests(false),
-		check_supplements(false), check_regexp_supplements(false),
-		check_enhances(false), check_regexp_enhances(false)
+		check_deps(false)
 	{
 		YCPValue kind_symbol = attributes->value(YCPSymbol("kind"));
 		if (!kind_symbol.isNull() && kind_symbol->isSymbol())
@@ -971,17 +993,11 @@ struct ResolvableFilter
 #define QUERY_DEPS(NAME) \
 		YCPValue value_regexp_##NAME = attributes->value(YCPSymbol(#NAME "_regexp")); \
 		if (!value_regexp_##NAME.isNull() && value_regexp_##NAME->isString()) \
-		{ \
-			check_regexp_##NAME = true; \
-			fill_deps(regexp_##NAME, zypp::sat::SolvAttr::NAME, value_regexp_##NAME->asString()->value(), true); \
-		} \
+			fill_deps(zypp::sat::SolvAttr::NAME, value_regexp_##NAME->asString()->value(), true); \
 		\
 		YCPValue str_##NAME = attributes->value(YCPSymbol(#NAME)); \
 		if (!str_##NAME.isNull() && str_##NAME->isString()) \
-		{ \
-			check_##NAME = true; \
-			fill_deps(NAME, zypp::sat::SolvAttr::NAME, str_##NAME->asString()->value(), false); \
-		}
+			fill_deps(zypp::sat::SolvAttr::NAME, str_##NAME->asString()->value(), false);
 
 		QUERY_DEPS(provides)
 		QUERY_DEPS(obsoletes)
@@ -999,6 +1015,39 @@ struct ResolvableFilter
 	// The main filtering function, returns true/false for each resolvable in the pool
 	// whether it matches the required criteria.
 	bool operator()(const zypp::PoolItem &r) const
+	{
+		return matches(r, true);
+	}
+
+	// Call the function for each matching resolvable until it returns false.
+	// With a dependency filter only the precomputed candidates are checked
+	// instead of scanning the whole pool.
+	template <class Function>
+	void forEach(Function fnc) const
+	{
+		if (check_deps)
+		{
+			for (const zypp::sat::Solvable &solvable : candidates)
+			{
+				zypp::PoolItem item(solvable);
+
+				if (matches(item, false) && !fnc(item))
+					return;
+			}
+		}
+		else
+		{
+			for (const zypp::PoolItem &item : zypp::ResPool::instance())
+			{
+				if (matches(item, false) && !fnc(item))
+					return;
+			}
+		}
+	}
+
+	// check the resolvable, the dependency filters are checked only if deps is true
+	// (not needed when iterating over the candidates)
+	bool matches(const zypp::PoolItem &r, bool deps) const
 	{
 		// check the kind
 		if (!kind.empty() && kind != r->kind())
@@ -1097,7 +1146,7 @@ struct ResolvableFilter
 			return false;
 
 		// check the repository
-		if (check_repo && pkg.logFindAlias(r->repoInfo().alias()) != repo)
+		if (check_repo && pkg.logFindRepo(r.satSolvable().repository()) != repo)
 			return false;
 
 		// check if on system by user
@@ -1109,28 +1158,13 @@ struct ResolvableFilter
 			return false;
 
 		// check the matching dependencies
-
-#define CHECK_DEPS(NAME) \
-		if (check_##NAME && NAME.find(zypp::sat::Solvable(r)) == NAME.end()) \
-			return false; \
-		if (check_regexp_##NAME && regexp_##NAME.find(zypp::sat::Solvable(r)) == regexp_##NAME.end()) \
+		if (deps && check_deps && !std::binary_search(candidates.begin(), candidates.end(), r.satSolvable()))
 			return false;
 
-		CHECK_DEPS(provides)
-		CHECK_DEPS(obsoletes)
-		CHECK_DEPS(conflicts)
-		CHECK_DEPS(requires)
-		CHECK_DEPS(recommends)
-		CHECK_DEPS(suggests)
-		CHECK_DEPS(supplements)
-		CHECK_DEPS(enhances)
-
-#undef CHECK_DEPS
-
 		return true;
 	}
 
-	// reference to PkgFunctions, we need to call PkgFunctions::logFindAlias()
+	// reference to PkgFunctions, we need to call PkgFunctions::logFindRepo()
 	const PkgFunctions &pkg;
 
 	std::string kind, name, status_str, transact_by_str, arch_str, version_str, path;
@@ -1153,34 +1187,38 @@ struct ResolvableFilter
 	bool check_license_confirmed, license_confirmed;
 	long long medium_nr;
 
-	// define dependency filters
-#define DEFINE_DEPS(NAME) \
-	bool check_##NAME; \
-	bool check_regexp_##NAME; \
-	std::set<zypp::sat::Solvable> regexp_##NAME; \
-	std::set<zypp::sat::Solvable> NAME;
-
-	DEFINE_DEPS(provides)
-	DEFINE_DEPS(obsoletes)
-	DEFINE_DEPS(conflicts)
-	DEFINE_DEPS(requires)
-	DEFINE_DEPS(recommends)
-	DEFINE_DEPS(suggests)
-	DEFINE_DEPS(supplements)
-	DEFINE_DEPS(enhances)
-
-#undef DEFINE_DEPS
+	// the dependency filters are evaluated in advance, the result is
+	// the intersection of all dependency queries sorted by the solvable ID
+	bool check_deps;
+	std::vector<zypp::sat::Solvable> candidates;
 
 private:
 
-    void fill_deps(std::set<zypp::sat::Solvable> &set, zypp::sat::SolvAttr attr, const std::string &query, bool regexp)
+    void fill_deps(zypp::sat::SolvAttr attr, const std::string &query, bool regexp)
     {
         zypp::PoolQuery q;
         regexp ? q.setMatchRegex() : q.setMatchExact();
         q.addAttribute(attr, query);
 
+        std::vector<zypp::sat::Solvable> found;
         for (zypp::PoolQuery::const_iterator it = q.begin(), end = q.end(); it != end; ++it)
-            set.insert(*it);
+            found.push_back(*it);
+
+        std::sort(found.begin(), found.end());
+        found.erase(std::unique(found.begin(), found.end()), found.end());
+
+        if (!check_deps)
+        {
+            check_deps = true;
+            candidates.swap(found);
+            return;
+        }
+
+        // all dependency filters must match
+        std::vector<zypp::sat::Solvable> matching;
+        std::set_intersection(candidates.begin(), candidates.end(), found.begin(), found.end(),
+            std::back_inserter(matching));
+        candidates.swap(matching);
     }
 };
 
@@ -1219,10 +1257,232 @@ YCPValue PkgFunctions::Resolvables(const YCPMap& filter, const YCPList& attrs)
 		y2warning("Passed empty attribute list, empty maps will be returned");
 
 	YCPList ret;
+	// convert the attribute list only once, not for each resolvable
+	ResolvableAttrs requested(attrs);
+
+	try {
+        ResolvableFilter(filter, *this).forEach([&](const zypp::PoolItem &r)
+        {
+            ret->add(Resolvable2YCPMap(r, false, false, requested));
+            return true;
+        });
+	}
+	catch(const zypp::MatchInvalidRegexException &e)
+	{
+		_last_error.setLastError(ExceptionAsString(e));
+		return YCPVoid();
+	}
+
+	return ret;
+}
+
+/**
+   @builtin ResolvablesColumns
+   @short Return the attributes of the resolvables matching the input filter
+	   as columns, this is more memory efficient than the Resolvables() call
+	   when reading many resolvables (e.g. all packages)
+   @param map filter
+   @param list attrs the list of required attributes
+   @return map the requested attribute name => list of values, the lists have the same
+	   size, the n-th item in each list belongs to the n-th found resolvable, nil is
+	   used when the resolvable does not have the attribute; nil is returned
+	   if an error occurred (call Pkg.LastError() to get the details)
+
+   See the Resolvables() call for the accepted filtering keys and attributes.
+
+   The repeated string values (like arch or vendor) are shared in the result,
+   the same value is stored only once.
+
+   Example (Ruby):
+	   Pkg.ResolvablesColumns({kind: :package}, [:name, :arch])
+	   # => {"name" => ["yast2", "zypper"], "arch" => ["noarch", "x86_64"]}
+*/
+YCPValue PkgFunctions::ResolvablesColumns(const YCPMap& filter, const YCPList& attrs)
+{
+	ResolvableAttrs requested(attrs);
+
+	struct Column
+	{
+		ResolvableAttrs::Attr attr;
+		YCPString key;
+		YCPList values;
+		// the already used string values
+		std::unordered_map<std::string, YCPString> strings;
+	};
+
+	std::vector<Column> columns;
+	columns.reserve(requested.size());
+
+	for (int i = 0; i < ResolvableAttrs::ATTR_COUNT; ++i)
+	{
+		ResolvableAttrs::Attr attr = static_cast<ResolvableAttrs::Attr>(i);
+
+		if (requested.contains(attr))
+			columns.push_back(Column{attr, YCPString(ResolvableAttrs::name(attr)), YCPList(), {}});
+	}
+
+	if (columns.empty())
+		y2warning("Passed empty attribute list, an empty map will be returned");
+
+	long long count = 0;
+
+	try {
+		ResolvableFilter(filter, *this).forEach([&](const zypp::PoolItem &r)
+		{
+			++count;
+
+			if (columns.empty())
+				return true;
+
+			// a temporary row, released after distributing the values
+			YCPMap row(Resolvable2YCPMap(r, false, false, requested));
+
+			for (Column &column : columns)
+			{
+				YCPValue value = row->value(column.key);
+
+				if (!value.isNull() && value->isString())
+				{
+					const std::string &str = value->asString()->value();
+					std::unordered_map<std::string, YCPString>::const_iterator it = column.strings.find(str);
+
+					if (it == column.strings.end())
+						column.strings.emplace(str, value->asString());
+					else
+						value = it->second;
+				}
+
+				column.values->add(value.isNull() ? YCPVoid() : value);
+			}
+
+			return true;
+		});
+	}
+	catch(const zypp::MatchInvalidRegexException &e)
+	{
+		_last_error.setLastError(ExceptionAsString(e));
+		return YCPVoid();
+	}
+
+	y2milestone("Found %lld resolvables, returning %zd columns", count, columns.size());
+
+	YCPMap ret;
+	for (const Column &column : columns)
+		ret->add(column.key, column.values);
+
+	return ret;
+}
+
+// An open ResolvablesOpen() query, the pool is scanned lazily
+// in ResolvablesNext(), only the current batch is kept in memory.
+class ResolvableCursor
+{
+  public:
+
+	// throws zypp::MatchInvalidRegexException for an invalid dependency filter
+	ResolvableCursor(const YCPMap &filter_map, const YCPList &attrs, const PkgFunctions &pf)
+		: pool(zypp::ResPool::instance()), serial(pool.serial().serial()),
+		filter(filter_map, pf), pool_pos(pool.begin()), candidate_pos(0), requested(attrs)
+	{}
+
+	// the pool content has been changed (e.g. a repository loaded or removed),
+	// the position is not valid anymore
+	bool invalidated() const { return pool.serial().serial() != serial; }
+
+	// find the next matching resolvable, returns false at the end
+	bool next(zypp::PoolItem &item)
+	{
+		// with a dependency filter check only the candidates
+		if (filter.check_deps)
+		{
+			while (candidate_pos < filter.candidates.size())
+			{
+				zypp::PoolItem r(filter.candidates[candidate_pos++]);
+
+				if (filter.matches(r, false))
+				{
+					item = r;
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		while (pool_pos != pool.end())
+		{
+			zypp::PoolItem r(*pool_pos);
+			++pool_pos;
+
+			if (filter.matches(r, false))
+			{
+				item = r;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	zypp::ResPool pool;
+	unsigned serial;
+
+	ResolvableFilter filter;
+	zypp::ResPool::const_iterator pool_pos;
+	size_t candidate_pos;
+
+	// the requested attributes
+	ResolvableAttrs requested;
+};
+
+void PkgFunctions::CloseStaleResolvableCursors()
+{
+	for (std::map<long long, std::shared_ptr<ResolvableCursor> >::iterator it = resolvable_cursors.begin();
+		it != resolvable_cursors.end();)
+	{
+		if (it->second->invalidated())
+		{
+			y2milestone("Closing resolvable query %lld, the pool has been changed", it->first);
+			resolvable_cursors.erase(it++);
+		}
+		else
+			++it;
+	}
+}
+
+/**
+   @builtin ResolvablesOpen
+   @short Start a query for the resolvables matching the input filter, the found
+	   resolvables are returned in batches by the ResolvablesNext() call.
+	   Unlike the Resolvables() call the whole result is not kept in memory.
+   @param map filter
+   @param list attrs the list of required attributes
+   @return integer handle for the ResolvablesNext() and ResolvablesClose() calls,
+	   nil if an error occurred (call Pkg.LastError() to get the details)
+
+   See the Resolvables() call for the accepted filtering keys and attributes.
+
+   The query becomes invalid when the pool content is changed (e.g. a repository
+   is loaded or removed), then ResolvablesNext() returns nil and the query is closed.
+
+   Examples (Ruby):
+	   handle = Pkg.ResolvablesOpen({kind: :package}, [:name, :version])
+	   while !(batch = Pkg.ResolvablesNext(handle, 1000)).empty?
+	     ...
+	   end
+	   Pkg.ResolvablesClose(handle)
+*/
+YCPValue PkgFunctions::ResolvablesOpen(const YCPMap& filter, const YCPList& attrs)
+{
+	if (attrs.isEmpty())
+		y2warning("Passed empty attribute list, empty maps will be returned");
+
+	// release the forgotten queries
+	CloseStaleResolvableCursors();
 
 	try {
-        for (const auto &r : zypp::ResPool::instance().filter(ResolvableFilter(filter, *this)) )
-            ret->add(Resolvable2YCPMap(r, false, false, attrs));
+		std::shared_ptr<ResolvableCursor> cursor(new ResolvableCursor(filter, attrs, *this));
+		resolvable_cursors[++last_cursor_id] = cursor;
 	}
 	catch(const zypp::MatchInvalidRegexException &e)
 	{
@@ -1230,9 +1490,81 @@ YCPValue PkgFunctions::Resolvables(const YCPMap& filter, const YCPList& attrs)
 		return YCPVoid();
 	}
 
+	y2debug("Opened resolvable query %lld (%zd open)", last_cursor_id, resolvable_cursors.size());
+	return YCPInteger(last_cursor_id);
+}
+
+/**
+   @builtin ResolvablesNext
+   @short Return the next batch of resolvables from a query started by ResolvablesOpen()
+   @param integer handle the query handle
+   @param integer count max. number of returned resolvables
+   @return list list of found resolvables (maps), an empty list when all resolvables
+	   have been returned, nil if the handle is invalid or the pool has been changed
+	   (call Pkg.LastError() to get the details)
+*/
+YCPValue PkgFunctions::ResolvablesNext(const YCPInteger& handle, const YCPInteger& count)
+{
+	if (handle.isNull() || count.isNull())
+	{
+		y2error("Invalid nil argument");
+		return YCPVoid();
+	}
+
+	std::map<long long, std::shared_ptr<ResolvableCursor> >::iterator it = resolvable_cursors.find(handle->value());
+
+	if (it == resolvable_cursors.end())
+	{
+		y2error("Invalid resolvable query handle: %lld", handle->value());
+		_last_error.setLastError(_("Invalid resolvable query handle."));
+		return YCPVoid();
+	}
+
+	ResolvableCursor &cursor = *it->second;
+
+	if (cursor.invalidated())
+	{
+		y2error("Resolvable query %lld is not valid, the pool has been changed", handle->value());
+		_last_error.setLastError(_("The resolvable pool has been changed."));
+		// do not keep the invalid pool iterators
+		resolvable_cursors.erase(it);
+		return YCPVoid();
+	}
+
+	YCPList ret;
+
+	zypp::PoolItem item;
+
+	for (long long i = 0; i < count->value() && cursor.next(item); ++i)
+		ret->add(Resolvable2YCPMap(item, false, false, cursor.requested));
+
 	return ret;
 }
 
+/**
+   @builtin ResolvablesClose
+   @short Close a query started by ResolvablesOpen() and release the resources
+   @param integer handle the query handle
+   @return boolean true on success, false if the handle is invalid
+*/
+YCPValue PkgFunctions::ResolvablesClose(const YCPInteger& handle)
+{
+	if (handle.isNull())
+	{
+		y2error("Invalid nil argument");
+		return YCPBoolean(false);
+	}
+
+	if (resolvable_cursors.erase(handle->value()) == 0)
+	{
+		y2warning("Invalid resolvable query handle: %lld", handle->value());
+		return YCPBoolean(false);
+	}
+
+	y2debug("Closed resolvable query %lld (%zd open)", handle->value(), resolvable_cursors.size());
+	return YCPBoolean(true);
+}
+
 /**
    @builtin AnyResolvable
    @short Is there any resolvable matching the input filter? If the regexp is invalid
@@ -1247,11 +1579,135 @@ YCPValue PkgFunctions::Resolvables(const YCPMap& filter, const YCPList& attrs)
 YCPValue PkgFunctions::AnyResolvable(const YCPMap& filter)
 {
 	try {
-		return YCPBoolean(!zypp::ResPool::instance().filter(ResolvableFilter(filter, *this)).empty());
+		bool found = false;
+
+		// stop at the first match
+		ResolvableFilter(filter, *this).forEach([&found](const zypp::PoolItem &)
+		{
+			found = true;
+			return false;
+		});
+
+		return YCPBoolean(found);
+	}
+	catch(const zypp::MatchInvalidRegexException &e)
+	{
+		_last_error.setLastError(ExceptionAsString(e));
+		return YCPVoid();
+	}
+}
+
+/**
+   @builtin BatchQuery
+   @short Evaluate several resolvable filters in one pass over the pool.
+	   It is faster than calling AnyResolvable() or Resolvables() several times.
+	   If a regexp is invalid nil is returned.
+   @param list filters list of filters (maps), see the Resolvables() call
+	   for the accepted filtering keys
+   @param symbol mode the requested result for each filter:
+	   `any - boolean, true if any resolvable matches the filter (like AnyResolvable()),
+	   `count - integer, number of the matching resolvables,
+	   `first - map, the first matching resolvable with the name, kind, version, arch,
+	   source and status attributes or nil if nothing matches
+   @return list list of results in the same order as the filters, nil
+	   if an error occurred (call Pkg.LastError() to get the details)
+
+   Example (Ruby):
+	   Pkg.BatchQuery([{provides: "pattern()"}, {name: "yast2", status: :installed}], :any)
+	   # => [true, false]
+*/
+YCPValue PkgFunctions::BatchQuery(const YCPList& filters, const YCPSymbol& mode)
+{
+	if (filters.isNull() || mode.isNull())
+	{
+		y2error("Invalid nil argument");
+		return YCPVoid();
+	}
+
+	std::string mode_str = mode->symbol();
+
+	if (mode_str != "any" && mode_str != "count" && mode_str != "first")
+	{
+		y2error("Invalid mode: %s", mode_str.c_str());
+		_last_error.setLastError(_("Invalid query mode: ") + mode_str);
+		return YCPVoid();
+	}
+
+	bool count_all = mode_str == "count";
+
+	std::vector<ResolvableFilter> queries;
+	queries.reserve(filters->size());
+
+	try {
+		for (int i = 0; i < filters->size(); ++i)
+		{
+			YCPValue filter = filters->value(i);
+
+			if (filter.isNull() || !filter->isMap())
+			{
+				y2error("Invalid filter at index %d: %s", i, filter.isNull() ? "nil" : filter->toString().c_str());
+				_last_error.setLastError(_("Invalid resolvable filter."));
+				return YCPVoid();
+			}
+
+			queries.emplace_back(filter->asMap(), *this);
+		}
 	}
 	catch(const zypp::MatchInvalidRegexException &e)
 	{
 		_last_error.setLastError(ExceptionAsString(e));
 		return YCPVoid();
 	}
+
+	std::vector<long long> counts(queries.size(), 0);
+	std::vector<zypp::PoolItem> first(queries.size());
+	// number of filters without any match
+	size_t pending = queries.size();
+
+	for (const zypp::PoolItem &item : zypp::ResPool::instance())
+	{
+		// all filters are satisfied, the rest of the pool is not needed
+		if (!count_all && pending == 0)
+			break;
+
+		for (size_t i = 0; i < queries.size(); ++i)
+		{
+			if (!count_all && counts[i] > 0)
+				continue;
+
+			if (queries[i](item) && counts[i]++ == 0)
+			{
+				first[i] = item;
+				--pending;
+			}
+		}
+	}
+
+	y2milestone("Evaluated %zd filters, %zd without any match", queries.size(), pending);
+
+	ResolvableAttrs attrs;
+	if (mode_str == "first")
+	{
+		attrs.add(ResolvableAttrs::ATTR_name);
+		attrs.add(ResolvableAttrs::ATTR_kind);
+		attrs.add(ResolvableAttrs::ATTR_version);
+		attrs.add(ResolvableAttrs::ATTR_arch);
+		attrs.add(ResolvableAttrs::ATTR_source);
+		attrs.add(ResolvableAttrs::ATTR_status);
+	}
+
+	YCPList ret;
+	for (size_t i = 0; i < queries.size(); ++i)
+	{
+		if (mode_str == "any")
+			ret->add(YCPBoolean(counts[i] > 0));
+		else if (count_all)
+			ret->add(YCPInteger(counts[i]));
+		else if (counts[i] > 0)
+			ret->add(Resolvable2YCPMap(first[i], false, false, attrs));
+		else
+			ret->add(YCPVoid());
+	}
+
+	return ret;
 }
@@ -0,0 +1,236 @@
+/*
+ * File:   SelectionSnapshots.cc
+ *
+ */
+
+#include "SelectionSnapshots.h"
+#include "PoolState.h"
+
+#include <set>
+
+#include <ycp/YCPString.h>
+#include <ycp/YCPSymbol.h>
+
+#include <zypp/PoolItem.h>
+#include <zypp/ResPool.h>
+#include <zypp/base/Easy.h>
+
+#define y2log_component "Pkg"
+#include <y2util/y2log.h>
+
+namespace
+{
+    YCPMap item_map(zypp::sat::detail::SolvableIdType id)
+    {
+	zypp::sat::Solvable solvable(id);
+
+	YCPMap ret;
+	ret->add(YCPString("name"), YCPString(solvable.name()));
+	ret->add(YCPString("kind"), YCPSymbol(solvable.kind().asString()));
+	ret->add(YCPString("version"), YCPString(solvable.edition().asString()));
+	ret->add(YCPString("arch"), YCPString(solvable.arch().asString()));
+
+	return ret;
+    }
+}
+
+SelectionSnapshots::SelectionSnapshots()
+{
+}
+
+void SelectionSnapshots::check()
+{
+    if (!_pool.changed())
+	return;
+
+    if (!_snapshots.empty())
+	y2warning("The pool has been changed, dropping %zd saved states", _snapshots.size());
+
+    clear();
+    _pool.update();
+}
+
+void SelectionSnapshots::clear()
+{
+    _snapshots.clear();
+    _base.clear();
+}
+
+bool SelectionSnapshots::changed(zypp::sat::detail::SolvableIdType id, const zypp::ResStatus &status) const
+{
+    return id >= _base.size() || !sameSelectionState(_base[id], status);
+}
+
+const zypp::ResStatus &SelectionSnapshots::status(const Changes &changes, zypp::sat::detail::SolvableIdType id) const
+{
+    Changes::const_iterator it = changes.find(id);
+    return it == changes.end() ? _base[id] : it->second;
+}
+
+SelectionSnapshots::Changes SelectionSnapshots::current() const
+{
+    Changes ret;
+    zypp::ResPool pool(zypp::ResPool::instance());
+
+    for_(it, pool.begin(), pool.end())
+    {
+	zypp::sat::detail::SolvableIdType id = it->satSolvable().id();
+
+	if (changed(id, it->status()))
+	    ret.emplace(id, it->status());
+    }
+
+    return ret;
+}
+
+void SelectionSnapshots::save(const std::string &name)
+{
+    check();
+
+    if (_base.empty())
+    {
+	zypp::ResPool pool(zypp::ResPool::instance());
+
+	for_(it, pool.begin(), pool.end())
+	{
+	    zypp::sat::detail::SolvableIdType id = it->satSolvable().id();
+
+	    if (id >= _base.size())
+		_base.resize(id + 1);
+
+	    _base[id] = it->status();
+	}
+
+	y2milestone("Saved the base state: %zd solvables", _base.size());
+    }
+
+    Changes &changes = _snapshots[name];
+    changes = current();
+
+    y2milestone("Saved state '%s': %zd changes", name.c_str(), changes.size());
+}
+
+int SelectionSnapshots::restore(const std::string &name)
+{
+    check();
+
+    std::map<std::string, Changes>::const_iterator snapshot = _snapshots.find(name);
+
+    if (snapshot == _snapshots.end())
+    {
+	y2error("State '%s' has not been saved", name.c_str());
+	return -1;
+    }
+
+    int restored = 0;
+    zypp::ResPool pool(zypp::ResPool::instance());
+
+    for_(it, pool.begin(), pool.end())
+    {
+	zypp::sat::detail::SolvableIdType id = it->satSolvable().id();
+
+	// a new solvable, not in the base
+	if (id >= _base.size())
+	    continue;
+
+	const zypp::ResStatus &saved = status(snapshot->second, id);
+
+	if (!sameSelectionState(it->status(), saved))
+	{
+	    it->status() = saved;
+	    ++restored;
+	}
+    }
+
+    y2milestone("Restored state '%s': %d changed items", name.c_str(), restored);
+
+    return restored;
+}
+
+bool SelectionSnapshots::remove(const std::string &name)
+{
+    bool ret = _snapshots.erase(name) > 0;
+
+    if (_snapshots.empty())
+	_base.clear();
+
+    return ret;
+}
+
+YCPList SelectionSnapshots::names()
+{
+    check();
+
+    YCPList ret;
+
+    for_(it, _snapshots.begin(), _snapshots.end())
+    {
+	ret->add(YCPString(it->first));
+    }
+
+    return ret;
+}
+
+bool SelectionSnapshots::diff(const std::string &from, const std::string &to, YCPMap &result)
+{
+    check();
+
+    std::map<std::string, Changes>::const_iterator from_it = _snapshots.find(from);
+    std::map<std::string, Changes>::const_iterator to_it = _snapshots.find(to);
+
+    if ((!from.empty() && from_it == _snapshots.end()) || (!to.empty() && to_it == _snapshots.end()))
+    {
+	y2error("State '%s' or '%s' has not been saved", from.c_str(), to.c_str());
+	return false;
+    }
+
+    // the current state is compared against the base (needs a pool scan),
+    // without any snapshot the base is empty and everything differs
+    Changes current_changes;
+    if ((from.empty() || to.empty()) && !_base.empty())
+	current_changes = current();
+
+    const Changes &from_changes = from.empty() ? current_changes : from_it->second;
+    const Changes &to_changes = to.empty() ? current_changes : to_it->second;
+
+    // only the items changed in any of them can differ
+    std::set<zypp::sat::detail::SolvableIdType> ids;
+    for_(it, from_changes.begin(), from_changes.end()) ids.insert(it->first);
+    for_(it, to_changes.begin(), to_changes.end()) ids.insert(it->first);
+
+    YCPList install, remove, neutral, lock, unlock;
+
+    for_(it, ids.begin(), ids.end())
+    {
+	zypp::sat::detail::SolvableIdType id = *it;
+
+	if (id >= _base.size())
+	    continue;
+
+	const zypp::ResStatus &a = status(from_changes, id);
+	const zypp::ResStatus &b = status(to_changes, id);
+
+	if (sameSelectionState(a, b))
+	    continue;
+
+	if (b.isToBeInstalled() && !a.isToBeInstalled())
+	    install->add(item_map(id));
+	else if (b.isToBeUninstalled() && !a.isToBeUninstalled())
+	    remove->add(item_map(id));
+	else if (!b.transacts() && a.transacts())
+	    neutral->add(item_map(id));
+
+	if (b.isLocked() && !a.isLocked())
+	    lock->add(item_map(id));
+	else if (!b.isLocked() && a.isLocked())
+	    unlock->add(item_map(id));
+    }
+
+    result->add(YCPSymbol("install"), install);
+    result->add(YCPSymbol("remove"), remove);
+    result->add(YCPSymbol("neutral"), neutral);
+    result->add(YCPSymbol("lock"), lock);
+    result->add(YCPSymbol("unlock"), unlock);
+
+    return true;
+}
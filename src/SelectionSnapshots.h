@@ -0,0 +1,76 @@
+/*
+ * File:   SelectionSnapshots.h
+ *
+ * Named snapshots of the resolvable states (see Pkg::SaveNamedState()).
+ *
+ * The first snapshot stores the status of all solvables in a base array
+ * indexed by the solvable ID, the snapshots keep only the statuses which
+ * differ from the base. The base is shared by all snapshots so comparing
+ * two snapshots needs only their differences, not the whole pool.
+ *
+ * The snapshots are dropped when the pool content changes (the solvable
+ * IDs are not valid anymore).
+ */
+
+#ifndef SelectionSnapshots_h
+#define SelectionSnapshots_h
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <ycp/YCPList.h>
+#include <ycp/YCPMap.h>
+
+#include <zypp/ResStatus.h>
+#include <zypp/sat/Solvable.h>
+
+#include "PoolState.h"
+
+class SelectionSnapshots
+{
+  public:
+
+    SelectionSnapshots();
+
+    // save the current status, an existing snapshot is replaced
+    void save(const std::string &name);
+
+    // restore the snapshot, returns the number of the changed items
+    // or -1 if the snapshot does not exist
+    int restore(const std::string &name);
+
+    bool remove(const std::string &name);
+    void clear();
+
+    YCPList names();
+
+    // the changes needed to get from snapshot 'from' to snapshot 'to',
+    // an empty name means the current status, returns false if a snapshot does not exist
+    bool diff(const std::string &from, const std::string &to, YCPMap &result);
+
+  private:
+
+    typedef std::unordered_map<zypp::sat::detail::SolvableIdType, zypp::ResStatus> Changes;
+
+    // drop the snapshots if the pool has been changed
+    void check();
+
+    // the status differs from the base
+    bool changed(zypp::sat::detail::SolvableIdType id, const zypp::ResStatus &status) const;
+
+    const zypp::ResStatus &status(const Changes &changes, zypp::sat::detail::SolvableIdType id) const;
+
+    // the changes of the current status against the base
+    Changes current() const;
+
+    PoolSerial _pool;
+
+    // the status of all solvables at the first snapshot
+    std::vector<zypp::ResStatus> _base;
+
+    std::map<std::string, Changes> _snapshots;
+};
+
+#endif // SelectionSnapshots_h
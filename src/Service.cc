@@ -26,7 +26,10 @@
 */
 
 #include "PkgFunctions.h"
+#include "ForkedWorkers.h"
 #include "PkgProgress.h"
+#include "HelpTexts.h"
+#include "Callbacks.h"
 #include "log.h"
 
 #include <ycp/YCPValue.h>
@@ -34,9 +37,20 @@
 #include <ycp/YCPMap.h>
 #include <ycp/YCPList.h>
 #include <ycp/YCPBoolean.h>
+#include <ycp/YCPInteger.h>
 #include <ycp/YCPVoid.h>
 #include <zypp/RepoInfo.h>
 
+#include <algorithm>
+#include <map>
+#include <unordered_set>
+#include <cerrno>
+#include <cstring>
+
+// exit codes of the service refresh worker process
+#define SERVICE_WORKER_OK 0
+#define SERVICE_WORKER_FAILED 1
+
 
 /**
    @builtin ServiceAliases
@@ -115,7 +129,7 @@ YCPValue PkgFunctions::ServiceDelete(const YCPString &alias)
 		    std::string repo_alias = repo->repoInfo().alias();
 		    y2milestone("Removing repository %lld (%s) belonging to service %s",
 			 index, repo_alias.c_str(), service_alias.c_str());
-		    repo->setDeleted();
+		    MarkRepoDeleted(index);
 		}
 	    }
 	}
@@ -304,7 +318,7 @@ YCPValue PkgFunctions::ServiceSet(const YCPString &old_alias, const YCPMap &serv
 		    y2milestone("%s repository %lld (%s) belonging to service %s",
 			 enabled ? "Enabling" : "Disabling", index, repo_alias.c_str(), old_alias_str.c_str());
 
-		    repo->repoInfo().setEnabled(enabled);
+		    repo->setEnabled(enabled);
 		}
 	    }
 	}
@@ -363,6 +377,63 @@ YCPValue PkgFunctions::ServiceSet(const YCPString &old_alias, const YCPMap &serv
     return YCPBoolean(false);
 }
 
+/*
+ Update the loaded repositories after refreshing the services. The repository
+ manager is scanned only once, the repositories from the refreshed services which
+ are not known anymore are unloaded, the new ones are added (but not refreshed
+ or loaded yet).
+*/
+void PkgFunctions::ReconcileServiceRepos(const std::set<std::string> &services, zypp::RepoManager *repomanager, RepoCont &added)
+{
+    // the services have changed the repository files
+    InvalidateKnownRepos();
+    const KnownRepoMap &known = KnownRepos();
+
+    // the known repositories which are already loaded
+    std::unordered_set<std::string> loaded;
+
+    for (RepoCont::size_type idx = 0; idx != repos.size(); ++idx)
+    {
+	YRepo_Ptr repo = repos[idx];
+
+	if (repo->isDeleted())
+	    continue;
+
+	const std::string alias(repo->repoInfo().alias());
+	KnownRepoMap::const_iterator found = known.find(alias);
+
+	if (found != known.end())
+	{
+	    y2debug("Reloading repository %s", alias.c_str());
+	    repo->repoInfo() = found->second;
+	    repo->resetDirty();
+	    loaded.insert(alias);
+	}
+	// the repositories not saved yet are not known by the repo manager,
+	// remove only the repositories from the refreshed services
+	else if (services.find(repo->repoInfo().service()) != services.end())
+	{
+	    y2milestone("Repository %s has been removed, unloading it", alias.c_str());
+	    RemoveResolvablesFrom(repo);
+	    MarkRepoDeleted(idx);
+	}
+    }
+
+    y2milestone("Checking for added repositories...");
+
+    // keep the order from the repo manager
+    for_(it, repomanager->repoBegin(), repomanager->repoEnd())
+    {
+	if (loaded.find(it->alias()) != loaded.end() || services.find(it->service()) == services.end())
+	    continue;
+
+	y2milestone("Service %s added a new repository: %s", it->service().c_str(), it->alias().c_str());
+	YRepo_Ptr new_repo = new YRepo(*it, true);
+	AddRepo(new_repo);
+	added.push_back(new_repo);
+    }
+}
+
 /**
    @builtin ServiceRefreshHelper
    @short Helper call for refreshing services
@@ -390,51 +461,21 @@ YCPValue PkgFunctions::ServiceRefreshHelper(const YCPString &alias, bool force)
 	    return YCPBoolean(false);
 	}
 
-	// reload all repositories
-	for (RepoCont::size_type idx = 0; idx != repos.size(); ++idx)
-	{
-	    YRepo_Ptr repo = repos[idx];
+	std::set<std::string> refreshed_services;
+	refreshed_services.insert(alias_str);
 
-	    // the repo has not been removed
-	    if (!repo->isDeleted())
-	    {
-		zypp::RepoInfo info(repo->repoInfo());
-		y2milestone("Reloading repository %s", info.alias().c_str());
+	RepoCont added;
+	ReconcileServiceRepos(refreshed_services, repomanager, added);
 
-		if (repomanager->hasRepo(info))
-		{
-		    repos[idx]->repoInfo() = repomanager->getRepositoryInfo(info.alias());
-		}
-		else
-		{
-		    y2milestone("Repository %s has been removed, unloading it", (info.alias().c_str()));
-		    RemoveResolvablesFrom(repo);
-		    repo->setDeleted();
-		}
-	    }
-	}
-
-        y2milestone("Checking for added repositories...");
-        // check whether there are new added repositories and load them
-        std::list<zypp::RepoInfo> reps = repomanager->knownRepositories();
-        for (std::list<zypp::RepoInfo>::iterator it = reps.begin();
-            it != reps.end(); ++it)
+        for (RepoCont::iterator it = added.begin(); it != added.end(); ++it)
         {
-          y2debug("Checking repo '%s' from service '%s'", it->alias().c_str(), it->service().c_str());
-          // skip repositories from other services or already loaded repositories
-          if (it->service() != alias_str || logFindAlias(it->alias()) > 0)
-            continue;
-
-          y2milestone("Service added a new repository: %s", it->alias().c_str());
-          YRepo_Ptr new_repo = new YRepo(*it);
-          repos.push_back(new_repo);
+          YRepo_Ptr new_repo = *it;
 
-          if (it->enabled())
+          if (new_repo->repoInfo().enabled())
           {
-            y2milestone("Refreshing repository: %s", it->alias().c_str());
-            // refresh the last added repository
+            y2milestone("Refreshing repository: %s", new_repo->repoInfo().alias().c_str());
 
-            YCPValue refreshed = SourceRefreshNow(repos.size() - 1);
+            YCPValue refreshed = SourceRefreshNow(YCPInteger(logFindAlias(new_repo->repoInfo().alias())));
             // return false on refresh failure
             if (!refreshed.isNull() && refreshed->isBoolean()
                 && !refreshed->asBoolean()->value())
@@ -484,6 +525,288 @@ YCPValue PkgFunctions::ServiceForceRefresh(const YCPString &alias)
    return ServiceRefreshHelper(alias, true);
 }
 
+int PkgFunctions::ServiceRefreshWorker(const std::string &alias, bool force)
+{
+    int ret = SERVICE_WORKER_FAILED;
+
+    try
+    {
+	if (service_manager.RefreshService(alias, *CreateRepoManager(), force))
+	    ret = SERVICE_WORKER_OK;
+    }
+    catch (const zypp::Exception& excpt)
+    {
+	y2error("Parallel refresh of service '%s' failed: %s", alias.c_str(), excpt.asString().c_str());
+    }
+
+    return ret;
+}
+
+bool PkgFunctions::ParallelServiceRefresh(const std::list<std::string> &services, bool force, int workers,
+    zypp::ProgressData &progress, std::list<std::string> &refreshed)
+{
+    y2milestone("Refreshing %zd services using %d workers", services.size(), workers);
+
+    ForkedWorkers procs([this] { _callbackHandler.disconnectReceivers(); });
+    // PID => service alias
+    std::map<pid_t, std::string> running;
+    std::list<std::string>::const_iterator next = services.begin();
+
+    auto finished = [&](pid_t pid, int status)
+    {
+	std::string alias(running[pid]);
+	running.erase(pid);
+
+	if (!ForkedWorkers::exited(status, SERVICE_WORKER_OK))
+	{
+	    y2warning("Parallel refresh of service '%s' failed, it will be refreshed again", alias.c_str());
+	    return;
+	}
+
+	refreshed.push_back(alias);
+	progress.incr();
+    };
+
+    while (next != services.end() || procs.running() > 0)
+    {
+	// start new workers up to the limit
+	while (next != services.end() && (int)procs.running() < workers)
+	{
+	    const std::string &alias = *next;
+	    pid_t pid = procs.start([&] { return ServiceRefreshWorker(alias, force); });
+
+	    if (pid < 0)
+	    {
+		// the remaining services will be refreshed sequentially
+		y2error("Cannot start a service refresh worker: %s", strerror(errno));
+		next = services.end();
+		break;
+	    }
+
+	    y2milestone("Refreshing service '%s' in process %d", alias.c_str(), pid);
+	    running[pid] = alias;
+	    ++next;
+	}
+
+	// wait a bit before checking the workers again
+	if (procs.collect(finished) == 0 && procs.running() > 0 && !procs.pause([&] { return progress.tick(); }))
+	{
+	    y2milestone("Parallel service refresh aborted");
+	    procs.killAll();
+	    return false;
+	}
+    }
+
+    return true;
+}
+
+/**
+   @builtin ServiceRefreshAll
+   @short Refresh all enabled services and load the repositories added by them
+   @description
+   The services are refreshed one by one, if the parallel refresh is enabled (see
+   Pkg::SetParallelRefresh()) they are refreshed in parallel worker processes and the
+   repository files are read only once afterwards.
+   The repositories removed by the services are unloaded, the new repositories are
+   refreshed in parallel and loaded. The progress is reported via the ProcessStart,
+   ProcessNextStage, ProcessProgress and ProcessFinished callbacks. The services must
+   already be saved on the system.
+
+   @param force force refresh even if TTL is not reached
+   @return boolean false if any service or repository failed, the failed ones are skipped
+*/
+YCPValue PkgFunctions::ServiceRefreshAll(const YCPBoolean &force)
+{
+    std::list<std::string> stages;
+    stages.push_back(_("Refresh Services"));
+    stages.push_back(_("Refresh Sources"));
+    stages.push_back(_("Load Data"));
+
+    PkgProgress pkgprogress(_callbackHandler);
+    pkgprogress.Start(_("Refreshing Services..."), stages, _(HelpTexts::load_resolvables));
+
+    YCPValue ret = ServiceRefreshAllImpl(!force.isNull() && force->value(), pkgprogress);
+
+    pkgprogress.Done();
+
+    return ret;
+}
+
+YCPValue PkgFunctions::ServiceRefreshAllImpl(bool force, PkgProgress &pkgprogress)
+{
+    bool success = true;
+    // the parallel refresh is used only when enabled by SetParallelRefresh()
+    int workers = parallel_refresh;
+
+    // the same weight for all three stages
+    zypp::ProgressData prog_total(300);
+    prog_total.sendTo(pkgprogress.Receiver());
+
+    try
+    {
+	zypp::RepoManager* repomanager = CreateRepoManager();
+
+	std::list<std::string> services;
+	ServiceManager::Services known_services(service_manager.GetServices());
+
+	for_(it, known_services.begin(), known_services.end())
+	{
+	    if (it->enabled())
+		services.push_back(it->alias());
+	}
+
+	std::list<std::string> refreshed;
+	std::set<std::string> refreshed_services;
+
+	{
+	    zypp::CombinedProgressData services_subprogress(prog_total, 100);
+	    zypp::ProgressData prog(services.size());
+	    prog.sendTo(services_subprogress);
+
+	    bool aborted = false;
+
+	    if (services.size() > 1 && workers > 1)
+	    {
+		aborted = !ParallelServiceRefresh(services, force, workers, prog, refreshed);
+
+		if (!refreshed.empty())
+		{
+		    // the workers have changed the repository and service files,
+		    // read them again (only once for all services)
+		    y2milestone("Reloading the repo manager...");
+		    delete repo_manager;
+		    repo_manager = NULL;
+		    repomanager = CreateRepoManager();
+
+		    for_(it, refreshed.begin(), refreshed.end())
+		    {
+			if (service_manager.ReloadService(*it, *repomanager))
+			    refreshed_services.insert(*it);
+		    }
+		}
+	    }
+
+	    if (aborted)
+	    {
+		y2warning("Skipping the refresh of the remaining services");
+		success = false;
+	    }
+
+	    // refresh the remaining services (or the failed ones again) in this process
+	    for_(it, services.begin(), services.end())
+	    {
+		if (aborted)
+		    break;
+
+		if (find(refreshed.begin(), refreshed.end(), *it) != refreshed.end())
+		    continue;
+
+		try
+		{
+		    if (service_manager.RefreshService(*it, *repomanager, force))
+			refreshed_services.insert(*it);
+		    else
+			success = false;
+		}
+		catch (const zypp::Exception& excpt)
+		{
+		    // continue with the other services
+		    y2error("Error in service refresh: %s", excpt.asString().c_str());
+		    _last_error.setLastError(std::string(_("Error refreshing service")) + " " + *it + ":\n\n"
+			+ ExceptionAsString(excpt));
+		    success = false;
+		}
+
+		prog.incr();
+	    }
+	}
+
+	RepoCont added;
+	ReconcileServiceRepos(refreshed_services, repomanager, added);
+
+	RepoCont enabled;
+	for_(it, added.begin(), added.end())
+	{
+	    if ((*it)->repoInfo().enabled())
+		enabled.push_back(*it);
+	}
+
+	y2milestone("Refreshed %zd of %zd services, %zd new repositories (%zd enabled)",
+	    refreshed_services.size(), services.size(), added.size(), enabled.size());
+
+	pkgprogress.NextStage();
+
+	{
+	    zypp::CombinedProgressData repos_subprogress(prog_total, 100);
+	    // refresh and cache rebuild
+	    zypp::ProgressData prog(enabled.size() * 200);
+	    prog.sendTo(repos_subprogress);
+
+	    RepoCont repos_refreshed;
+	    RepoCont cache_built;
+
+	    autorefresh_skipped = false;
+
+	    // the refresh callbacks are called for both the parallel and the sequential refresh
+	    if (!enabled.empty())
+		CallRefreshStarted();
+
+	    if (enabled.size() > 1 && workers > 1)
+	    {
+		ParallelAutorefresh(enabled, repomanager, prog, repos_refreshed, cache_built, success, workers);
+
+		// the cache rebuild step of the repositories without autorefresh is skipped
+		for_(it, repos_refreshed.begin(), repos_refreshed.end())
+		{
+		    if (find(cache_built.begin(), cache_built.end(), *it) == cache_built.end())
+			prog.incr(100);
+		}
+	    }
+
+	    for_(it, enabled.begin(), enabled.end())
+	    {
+		if (autorefresh_skipped)
+		    break;
+
+		if (find(repos_refreshed.begin(), repos_refreshed.end(), *it) != repos_refreshed.end())
+		    continue;
+
+		y2milestone("Refreshing repository: %s", (*it)->repoInfo().alias().c_str());
+		YCPValue ret = SourceRefreshNow(YCPInteger(logFindAlias((*it)->repoInfo().alias())));
+
+		if (!ret.isNull() && ret->isBoolean() && !ret->asBoolean()->value())
+		    success = false;
+
+		prog.incr(200);
+	    }
+
+	    if (!enabled.empty())
+		CallRefreshDone();
+	}
+
+	pkgprogress.NextStage();
+
+	{
+	    zypp::CombinedProgressData load_subprogress(prog_total, 100);
+	    zypp::ProgressData prog(enabled.size() * 100);
+	    prog.sendTo(load_subprogress);
+
+	    for_(it, enabled.begin(), enabled.end())
+	    {
+		zypp::CombinedProgressData repo_subprogress(prog, 100);
+		success = LoadResolvablesFrom(*it, repo_subprogress) && success;
+	    }
+	}
+    }
+    catch (const zypp::Exception& excpt)
+    {
+	_last_error.setLastError(ExceptionAsString(excpt));
+	success = false;
+    }
+
+    return YCPBoolean(success);
+}
+
 /**
    @builtin ServiceProbe
    @short Probe service type at a URL
@@ -138,6 +138,19 @@ bool ServiceManager::RefreshService(const std::string &alias, zypp::RepoManager
         return true;
     }
 
+    return ReloadService(alias, repomgr);
+}
+
+bool ServiceManager::ReloadService(const std::string &alias, const zypp::RepoManager &repomgr)
+{
+    PkgServices::iterator serv_it = _known_services.find(alias);
+
+    if (serv_it == _known_services.end())
+    {
+	y2error("Service '%s' does not exist", alias.c_str());
+	return false;
+    }
+
     // load the service from disk
     PkgService new_service(repomgr.getService(alias), alias);
     DBG << "Reloaded service: " << new_service;
@@ -0,0 +1,138 @@
+/*
+ * File:   SolverCache.cc
+ *
+ */
+
+#include "SolverCache.h"
+#include "PoolState.h"
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <functional>
+
+#include <zypp/Locale.h>
+#include <zypp/PoolItem.h>
+#include <zypp/ResPool.h>
+#include <zypp/base/Easy.h>
+#include <zypp/sat/Pool.h>
+
+#define y2log_component "Pkg"
+#include <y2util/y2log.h>
+
+namespace
+{
+    void combine(size_t &seed, size_t value)
+    {
+	seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    }
+}
+
+SolverCache::SolverCache()
+    : _valid(false), _fingerprint(0), _result(false), _hits(0), _misses(0)
+{
+}
+
+size_t SolverCache::fingerprint(const zypp::Resolver_Ptr &resolver)
+{
+    size_t ret = PoolSerial::current();
+
+    // the solver input, the solver results (transactions by SOLVER)
+    // are reset by the solver itself
+    for_(it, zypp::ResPool::instance().begin(), zypp::ResPool::instance().end())
+    {
+	const zypp::ResStatus &status = it->status();
+
+	if (status.getTransactByValue() == zypp::ResStatus::SOLVER && !status.isLocked())
+	    continue;
+
+	combine(ret, it->satSolvable().id());
+	combine(ret, status.getTransactValue());
+	combine(ret, status.getTransactByValue());
+	combine(ret, status.isToBeInstalled());
+    }
+
+    combine(ret, resolver->onlyRequires());
+    combine(ret, resolver->ignoreAlreadyRecommended());
+    combine(ret, resolver->allowVendorChange());
+    combine(ret, resolver->upgradeMode());
+    combine(ret, resolver->updateMode());
+
+#ifdef HAVE_ZYPP_DUP_FLAGS
+    combine(ret, resolver->dupAllowDowngrade());
+    combine(ret, resolver->dupAllowNameChange());
+    combine(ret, resolver->dupAllowArchChange());
+    combine(ret, resolver->dupAllowVendorChange());
+#endif
+
+    const zypp::LocaleSet &locales = zypp::sat::Pool::instance().getRequestedLocales();
+    for_(it, locales.begin(), locales.end())
+    {
+	combine(ret, std::hash<std::string>()(it->code()));
+    }
+
+    return ret;
+}
+
+bool SolverCache::lookup(size_t fp, bool &result)
+{
+    if (!_valid || fp != _fingerprint)
+    {
+	++_misses;
+	return false;
+    }
+
+    int restored = 0;
+
+    for_(it, zypp::ResPool::instance().begin(), zypp::ResPool::instance().end())
+    {
+	zypp::sat::detail::SolvableIdType id = it->satSolvable().id();
+
+	if (id < _status.size() && !sameSelectionState(it->status(), _status[id]))
+	{
+	    it->status() = _status[id];
+	    ++restored;
+	}
+    }
+
+    ++_hits;
+    result = _result;
+
+    y2milestone("Solver input not changed, using the previous result (%s), restored items: %d",
+	result ? "true" : "false", restored);
+
+    return true;
+}
+
+void SolverCache::store(size_t fp, bool result, const zypp::ResolverProblemList &problems)
+{
+    _status.clear();
+
+    for_(it, zypp::ResPool::instance().begin(), zypp::ResPool::instance().end())
+    {
+	zypp::sat::detail::SolvableIdType id = it->satSolvable().id();
+
+	if (id >= _status.size())
+	    _status.resize(id + 1);
+
+	_status[id] = it->status();
+    }
+
+    _problems = problems;
+    _result = result;
+    _fingerprint = fp;
+    _valid = true;
+}
+
+void SolverCache::invalidate()
+{
+    if (!_valid)
+	return;
+
+    y2debug("Invalidating the solver cache");
+
+    _valid = false;
+    _status.clear();
+    _problems.clear();
+}
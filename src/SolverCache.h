@@ -0,0 +1,67 @@
+/*
+ * File:   SolverCache.h
+ *
+ * The result of the last solver run (see Pkg::PkgSolve()). The solver
+ * input is summarized by a fingerprint: the transactions and locks set
+ * by the user or by the application (not by the solver), the solver
+ * flags and the requested locales. When the fingerprint does not change
+ * the solver would compute the same result again so the stored statuses
+ * and problems are used instead.
+ *
+ * The resolver keeps some input which cannot be read back (the extra
+ * requires/conflicts, the applied solutions), the cache must be
+ * invalidated explicitly when it changes or when the solver is run
+ * in another way (upgrade, verify).
+ */
+
+#ifndef SolverCache_h
+#define SolverCache_h
+
+#include <cstddef>
+#include <vector>
+
+#include <zypp/ResStatus.h>
+#include <zypp/Resolver.h>
+#include <zypp/ProblemTypes.h>
+
+class SolverCache
+{
+  public:
+
+    SolverCache();
+
+    // the fingerprint of the current solver input
+    static size_t fingerprint(const zypp::Resolver_Ptr &resolver);
+
+    // the input has not changed since the stored run, the stored statuses
+    // are restored and the stored result is returned in 'result'
+    bool lookup(size_t fp, bool &result);
+
+    // store the result of a solver run with the input 'fp'
+    void store(size_t fp, bool result, const zypp::ResolverProblemList &problems);
+
+    void invalidate();
+
+    bool valid() const { return _valid; }
+
+    // the problems found by the stored run
+    const zypp::ResolverProblemList &problems() const { return _problems; }
+
+    long long hits() const { return _hits; }
+    long long misses() const { return _misses; }
+
+  private:
+
+    bool _valid;
+    size_t _fingerprint;
+    bool _result;
+
+    // the status of all solvables after the solver run, indexed by the solvable ID
+    std::vector<zypp::ResStatus> _status;
+    zypp::ResolverProblemList _problems;
+
+    long long _hits;
+    long long _misses;
+};
+
+#endif // SolverCache_h
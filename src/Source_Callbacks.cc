@@ -131,6 +131,9 @@ void PkgFunctions::RefreshWithCallbacks(const zypp::RepoInfo &repo, const zypp::
     {
 	zypp::RepoManager* repomanager = CreateRepoManager();
 	repomanager->refreshMetadata(repo, refresh, progressrcv);
+
+	// the cached files might not match the new metadata
+	download_cache.invalidate(repo.alias());
     }
     catch(...)
     {
@@ -300,7 +300,7 @@ PkgFunctions::createManagedSource( const zypp::Url & url_r,
 
     prg.toMax();
 }
-    repos.push_back(new YRepo(repo));
+    AddRepo(new YRepo(repo));
 
     y2milestone("Added source '%s': '%s', enabled: %s, autorefresh: %s",
 	repo.alias().c_str(),
@@ -427,10 +427,7 @@ YCPValue PkgFunctions::RepositoryAdd(const YCPMap &params)
 
 	if (check_alias)
 	{
-	    // search in stored repositories
-	    std::list<zypp::RepoInfo> reps = CreateRepoManager()->knownRepositories();
-
-	    if (aliasExists(alias, reps))
+	    if (aliasExists(alias))
 	    {
 		y2error("alias %s already exists", alias.c_str());
 		return YCPVoid();
@@ -504,7 +501,7 @@ YCPValue PkgFunctions::RepositoryAdd(const YCPMap &params)
     MIL << "Adding repository:" << std::endl;
     MIL << repo << std::endl;
 
-    repos.push_back(new YRepo(repo));
+    AddRepo(new YRepo(repo));
 
     // the new source is at the end of the list
     return YCPInteger(repos.size() - 1);
@@ -35,6 +35,9 @@
 #include <HelpTexts.h>
 
 #include <zypp/Fetcher.h>
+#include <zypp/PathInfo.h>
+
+#include <map>
 
 /*
   Textdomain "pkg-bindings"
@@ -53,6 +56,8 @@ YCPValue PkgFunctions::SourceProvideFileCommon(const YCPInteger &id,
 	return YCPVoid();
     }
 
+    download_cache.startRequest();
+
     CallInitDownload(std::string(_("Downloading ") + f->value()));
 
     bool found = true;
@@ -84,7 +89,15 @@ YCPValue PkgFunctions::SourceProvideFileCommon(const YCPInteger &id,
     {
 	try
 	{
-	    if (check_signatures)
+	    std::string cache_key = DownloadCache::key(repo->repoInfo().alias(), mid->value(), f->value(),
+		digested ? "digested" : "signed");
+
+	    // already downloaded
+	    if (check_signatures && !(path = download_cache.find(cache_key)).empty())
+	    {
+		y2milestone("local path: '%s'", path.asString().c_str());
+	    }
+	    else if (check_signatures)
 	    {
 		// use a Fetcher for downloading signed files (see bnc#409927)
 		zypp::Fetcher fch;
@@ -103,9 +116,6 @@ YCPValue PkgFunctions::SourceProvideFileCommon(const YCPInteger &id,
 
 		// create the tmpdir in <_download_area>
 		zypp::filesystem::TmpDir tmpdir(download_area_path());
-
-		// keep a reference to the tmpdir so the directory is not deleted at the and of the block		
-		tmp_dirs.push_back(tmpdir);
 		path = tmpdir.path();
 
 		if (digested)
@@ -120,6 +130,11 @@ YCPValue PkgFunctions::SourceProvideFileCommon(const YCPInteger &id,
 		fch.start(path, *repo->mediaAccess()); // uses MediaAccess to retrieve
 		fch.reset();
 		path /= f->value();
+
+		// keep a reference to the tmpdir so the directory is not deleted at the and of the block,
+		// a missing optional file is not cached
+		if (zypp::PathInfo(path).isExist())
+		    download_cache.add(cache_key, repo->repoInfo().alias(), tmpdir, path);
 	    }
 	    else
 	    {
@@ -226,6 +241,8 @@ PkgFunctions::SourceProvideOptionalFile (const YCPInteger& id, const YCPInteger&
  * Make a signed Let an InstSrc provide some file (make it available at the local filesystem).
  * The signature is read from <filename>.asc file, the GPG key is read from <filename>.key file.
  * Warning: The downloaded files are removed in Pkg::SourceReleaseAll()!
+ * The file is kept in the download cache, the size limit applies only to the released
+ * files (see SourceDownloadCacheDone() and SourceDownloadCacheSetLimit()).
  *
  * @param integer id Source ID
  * @param integer mid Number of the media the file is located on ('1' for the 1st media).
@@ -254,6 +271,8 @@ PkgFunctions::SourceProvideSignedFile (const YCPInteger& id, const YCPInteger& m
  * Make a signed Let an InstSrc provide some file (make it available at the local filesystem).
  * The checksum is stored either in /content file or in SHA1SUMS file.
  * Warning: The downloaded files are removed in Pkg::SourceReleaseAll()!
+ * The file is kept in the download cache, the size limit applies only to the released
+ * files (see SourceDownloadCacheDone() and SourceDownloadCacheSetLimit()).
  *
  * @param integer id Source ID
  * @param integer mid Number of the media the file is located on ('1' for the 1st media).
@@ -274,6 +293,290 @@ PkgFunctions::SourceProvideDigestedFile (const YCPInteger& id, const YCPInteger&
     return SourceProvideFileCommon(id, mid, f, optional->value() /*optional*/, true /* signed */, true /* digested */);
 }
 
+/**
+ * @builtin SourceProvideFiles
+ *
+ * @short Make several files available at the local filesystem
+ * @description
+ * Download several files from the same repository and medium at once. All files
+ * are queued into a single fetcher and downloaded into one directory, the download
+ * callbacks are called only once for the whole batch.
+ * Warning: The downloaded files are removed in Pkg::SourceReleaseAll()!
+ * The files are kept in the download cache, the size limit applies only to the released
+ * files (see SourceDownloadCacheDone() and SourceDownloadCacheSetLimit()).
+ *
+ * @param integer id Source ID
+ * @param integer mid Number of the media the files are located on ('1' for the 1st media).
+ * @param list<string> files Filenames relative to the media root.
+ * @param map options Download options:
+ *   "optional" (boolean) the files can be missing on the medium, do not ask user
+ *     for another medium (default: false),
+ *   "check" (symbol) `none - do not check the files (default), `signed - the files must be
+ *     signed (see SourceProvideSignedFile()), `digested - the files must have a checksum
+ *     (see SourceProvideDigestedFile())
+ *
+ * @return map file name => local path, nil for a missing optional file;
+ *   nil if the download failed (call Pkg.LastError() to get the details)
+ **/
+YCPValue
+PkgFunctions::SourceProvideFiles(const YCPInteger& id, const YCPInteger& mid, const YCPList& files, const YCPMap& options)
+{
+    if (id.isNull() || mid.isNull() || files.isNull())
+    {
+	y2error("SourceProvideFiles: nil argument!");
+	return YCPVoid();
+    }
+
+    download_cache.startRequest();
+
+    bool optional = false;
+    std::string check("none");
+
+    if (!options.isNull())
+    {
+	YCPValue optional_value = options->value(YCPString("optional"));
+	if (!optional_value.isNull() && optional_value->isBoolean())
+	    optional = optional_value->asBoolean()->value();
+
+	YCPValue check_value = options->value(YCPString("check"));
+	if (!check_value.isNull() && check_value->isSymbol())
+	    check = check_value->asSymbol()->symbol();
+    }
+
+    if (check != "none" && check != "signed" && check != "digested")
+    {
+	y2error("SourceProvideFiles: invalid check value: %s", check.c_str());
+	_last_error.setLastError(_("Invalid file check option: ") + check);
+	return YCPVoid();
+    }
+
+    std::list<std::string> file_names;
+    for (int i = 0; i < files->size(); ++i)
+    {
+	if (files->value(i).isNull() || !files->value(i)->isString())
+	{
+	    y2warning("SourceProvideFiles: ignoring invalid file name: %s",
+		files->value(i).isNull() ? "nil" : files->value(i)->toString().c_str());
+	    continue;
+	}
+
+	file_names.push_back(files->value(i)->asString()->value());
+    }
+
+    YRepo_Ptr repo = logFindRepository(id->value());
+    if (!repo)
+	return YCPVoid();
+
+    // the local paths of the found files
+    std::map<std::string, zypp::filesystem::Pathname> local_paths;
+    // the files which need to be downloaded
+    std::list<std::string> to_download;
+
+    for (std::list<std::string>::const_iterator it = file_names.begin(); it != file_names.end(); ++it)
+    {
+	zypp::filesystem::Pathname cached = download_cache.find(DownloadCache::key(repo->repoInfo().alias(),
+	    mid->value(), *it, check));
+
+	if (cached.empty())
+	    to_download.push_back(*it);
+	else
+	    local_paths[*it] = cached;
+    }
+
+    y2milestone("Providing %zd %sfiles (check: %s, cached: %zd) from repository %lld, medium %lld",
+	file_names.size(), (optional ? "optional " : ""), check.c_str(), local_paths.size(), id->value(), mid->value());
+
+    if (!to_download.empty())
+    {
+	CallInitDownload(std::string(_("Downloading files")));
+
+	extern ZyppRecipients::MediaChangeSensitivity _silent_probing;
+	// remember the current value
+	ZyppRecipients::MediaChangeSensitivity _silent_probing_old = _silent_probing;
+
+	// disable media change callback for optional files
+	if (optional)
+	    _silent_probing = ZyppRecipients::MEDIA_CHANGE_OPTIONALFILE;
+
+	// remember the current repo (needed at GPG key import)
+	current_repo = id->value();
+
+	bool success = true;
+
+	try
+	{
+	    zypp::Fetcher fch;
+	    fch.reset();
+
+	    if (check != "none")
+		fch.setOptions(zypp::Fetcher::AutoAddIndexes);
+
+	    for (std::list<std::string>::const_iterator it = to_download.begin(); it != to_download.end(); ++it)
+	    {
+		// path - add "/" to the beginning if it's missing there
+		std::string media_path(*it);
+		if (media_path.size() >= 1 && media_path[0] != '/')
+		{
+		    media_path = "/" + media_path;
+		}
+
+		zypp::OnMediaLocation mloc(media_path, mid->value());
+		mloc.setOptional(optional);
+
+		if (check == "digested")
+		    fch.enqueueDigested(mloc);
+		else if (check == "signed")
+		    fch.addIndex(mloc);
+		else
+		    fch.enqueue(mloc);
+	    }
+
+	    // create the tmpdir in <_download_area>, one for all files
+	    zypp::filesystem::TmpDir tmpdir(download_area_path());
+
+	    fch.start(tmpdir.path(), *repo->mediaAccess()); // uses MediaAccess to retrieve
+	    fch.reset();
+
+	    for (std::list<std::string>::const_iterator it = to_download.begin(); it != to_download.end(); ++it)
+	    {
+		zypp::filesystem::Pathname file_path = tmpdir.path() / *it;
+
+		// an optional file might be missing
+		if (!zypp::PathInfo(file_path).isExist())
+		    continue;
+
+		// the cache keeps a reference to the tmpdir so the directory is not deleted
+		download_cache.add(DownloadCache::key(repo->repoInfo().alias(), mid->value(), *it, check),
+		    repo->repoInfo().alias(), tmpdir, file_path);
+		local_paths[*it] = file_path;
+	    }
+	}
+	catch (const zypp::Exception& excpt)
+	{
+	    success = false;
+	    _last_error.setLastError(ExceptionAsString(excpt));
+	    y2error("Download failed: %s", excpt.asString().c_str());
+	}
+
+	current_repo = -1LL;
+
+	// set the original probing value
+	_silent_probing = _silent_probing_old;
+
+	CallDestDownload();
+
+	if (!success)
+	    return YCPVoid();
+    }
+
+    YCPMap ret;
+    for (std::list<std::string>::const_iterator it = file_names.begin(); it != file_names.end(); ++it)
+    {
+	std::map<std::string, zypp::filesystem::Pathname>::const_iterator found = local_paths.find(*it);
+
+	if (found != local_paths.end())
+	{
+	    ret->add(YCPString(*it), YCPString(found->second.asString()));
+	}
+	else
+	{
+	    y2milestone("File not found: %s", it->c_str());
+	    ret->add(YCPString(*it), YCPVoid());
+	}
+    }
+
+    return ret;
+}
+
+/**
+ * @builtin SourceDownloadCacheRelease
+ *
+ * @short Remove the files downloaded by the SourceProvide*() calls
+ * @description
+ * The signed and digested files and directories and the files provided
+ * by SourceProvideFiles() are kept in a cache so they are not downloaded
+ * again. The paths returned by these calls are not valid after calling this function.
+ *
+ * @return integer number of removed files or directories
+ **/
+YCPValue
+PkgFunctions::SourceDownloadCacheRelease()
+{
+    return YCPInteger(download_cache.release());
+}
+
+/**
+ * @builtin SourceDownloadCacheDone
+ *
+ * @short Release the downloaded files which are not used anymore
+ * @description
+ * The paths returned by the SourceProvide*() calls are valid until they are released
+ * by this function, by SourceDownloadCacheRelease() or by SourceReleaseAll(). The
+ * released files are kept in the cache for the next requests until they are removed
+ * by the size limit (see SourceDownloadCacheSetLimit()), the paths must not be used
+ * after calling this function. Not needed after SourceDownloadCacheSetLimit(), the
+ * paths are then released automatically by the next SourceProvide*() call.
+ *
+ * @param list<string> paths the paths returned by the SourceProvide*() calls
+ * @return integer number of released paths, nil on error
+ **/
+YCPValue
+PkgFunctions::SourceDownloadCacheDone(const YCPList &paths)
+{
+    if (paths.isNull())
+    {
+	y2error("Pkg::SourceDownloadCacheDone: nil parameter");
+	return YCPVoid();
+    }
+
+    int ret = 0;
+
+    for (int i = 0; i < paths->size(); ++i)
+    {
+	if (paths->value(i).isNull() || !paths->value(i)->isString())
+	{
+	    y2warning("SourceDownloadCacheDone: ignoring invalid path: %s",
+		paths->value(i).isNull() ? "nil" : paths->value(i)->toString().c_str());
+	    continue;
+	}
+
+	if (download_cache.unpin(paths->value(i)->asString()->value()))
+	    ++ret;
+    }
+
+    return YCPInteger(ret);
+}
+
+/**
+ * @builtin SourceDownloadCacheSetLimit
+ *
+ * @short Set the max. size of the cached downloaded files
+ * @description
+ * The size of the temporary directories (including the index and the signature
+ * files) is counted. When the limit is exceeded the least recently used released
+ * files are removed, the files still in use are never removed.
+ *
+ * By default (100MiB limit) the returned paths are in use until they are released by
+ * SourceDownloadCacheDone(). Setting the limit enables the automatic release: the paths
+ * returned by a SourceProvide*() call are valid only until the next SourceProvide*()
+ * call, copy the files if they are needed later.
+ *
+ * @param integer limit max. size in bytes
+ * @return boolean true on success, false if the limit is invalid
+ **/
+YCPValue
+PkgFunctions::SourceDownloadCacheSetLimit(const YCPInteger &limit)
+{
+    if (limit.isNull() || limit->value() < 0)
+    {
+	y2error("Invalid download cache limit: %s", limit.isNull() ? "nil" : limit->toString().c_str());
+	return YCPBoolean(false);
+    }
+
+    download_cache.setLimit(limit->value());
+    return YCPBoolean(true);
+}
+
 /**
  * @builtin SourceProvideDirectory
  * @short make a directory available at the local filesystem
@@ -304,6 +607,8 @@ PkgFunctions::SourceProvideDirectory(const YCPInteger& id, const YCPInteger& mid
  * all the files within it. Requires that all files have been signed with SHA1 checksum.
  * If there is no checksum or the checksum doesn't match the download fails.
  * Warning: The downloaded files are removed in Pkg::SourceReleaseAll()!
+ * The directory is kept in the download cache, the size limit applies only to the released
+ * directories (see SourceDownloadCacheDone() and SourceDownloadCacheSetLimit()).
  *
  * @param integer id repository to use (id)
  * @param integer mid Number of the media where the directory is located on ('1' for the 1st media).
@@ -322,6 +627,8 @@ PkgFunctions::SourceProvideSignedDirectory(const YCPInteger& id, const YCPIntege
 YCPValue
 PkgFunctions::SourceProvideDirectoryInternal(const YCPInteger& id, const YCPInteger& mid, const YCPString& d, const YCPBoolean &optional, const YCPBoolean &recursive, bool check_signatures)
 {
+    download_cache.startRequest();
+
     CallInitDownload(std::string(_("Downloading ") + d->value()));
 
     bool found = true;
@@ -343,7 +650,15 @@ PkgFunctions::SourceProvideDirectoryInternal(const YCPInteger& id, const YCPInte
     {
 	try
 	{
-	    if (check_signatures)
+	    std::string cache_key = DownloadCache::key(repo->repoInfo().alias(), mid->value(), d->value(),
+		recursive->value() ? "digested_dir_recursive" : "digested_dir");
+
+	    // already downloaded
+	    if (check_signatures && !(path = download_cache.find(cache_key)).empty())
+	    {
+		y2milestone("local path: '%s'", path.asString().c_str());
+	    }
+	    else if (check_signatures)
 	    {
 		// use a Fetcher for downloading signed files (see bnc#409927)
 		zypp::Fetcher f;
@@ -352,13 +667,14 @@ PkgFunctions::SourceProvideDirectoryInternal(const YCPInteger& id, const YCPInte
 		// create the tmpdir in <_download_area>
 		zypp::filesystem::TmpDir tmpdir(download_area_path());
 
-		// keep the reference to the tmpdir so the directory is not deleted at the and of the block
-		tmp_dirs.push_back(tmpdir);
 		path = tmpdir.path();
 		f.setOptions(zypp::Fetcher::AutoAddIndexes);
 		f.enqueueDigestedDir(mloc, recursive->value());
 		f.start(path, *repo->mediaAccess()); // uses MediaAccess to retrieve
 		f.reset();
+
+		// keep the reference to the tmpdir so the directory is not deleted at the and of the block
+		download_cache.add(cache_key, repo->repoInfo().alias(), tmpdir, path);
 	    }
 	    else
 	    {
@@ -29,11 +29,26 @@
 #include <Callbacks.YCP.h>
 
 #include <PkgFunctions.h>
+#include <ForkedWorkers.h>
 #include "log.h"
 
 #include <PkgProgress.h>
 #include <HelpTexts.h>
 
+#include <ycp/YCPInteger.h>
+
+#include <map>
+#include <cerrno>
+#include <cstring>
+
+// WIFEXITED()
+#include <sys/wait.h>
+
+// exit codes of the refresh worker process
+#define REFRESH_WORKER_OK 0
+#define REFRESH_WORKER_FAILED 1
+#define REFRESH_WORKER_NOT_NEEDED 2
+
 /*
   Textdomain "pkg-bindings"
 */
@@ -98,6 +113,7 @@ PkgFunctions::SourceRestore()
 				{
 				    y2milestone("Autorefreshing service %s (%s)...", srv_it->alias().c_str(), url.asString().c_str());
 				    service_manager.RefreshService(srv_it->alias(), *repomanager);
+				    InvalidateKnownRepos();
 				}
 			    }
 			}
@@ -125,7 +141,7 @@ PkgFunctions::SourceRestore()
 	for (std::list<zypp::RepoInfo>::iterator it = reps.begin();
 	    it != reps.end(); ++it)
 	{
-	    repos.push_back(new YRepo(*it));
+	    AddRepo(new YRepo(*it, true));
 	}
         _source_loaded = true;
     }
@@ -200,6 +216,165 @@ YCPValue PkgFunctions::SkipRefresh()
     return YCPVoid();
 }
 
+/**
+ * @builtin SetParallelRefresh
+ *
+ * @short Refresh several repositories at once in SourceLoad()
+ * @description
+ * Set the maximum number of repositories which are refreshed at once
+ * by the autorefresh in SourceLoad() and SourceStartManager(). The cache
+ * of a repository is rebuilt as soon as its metadata are downloaded.
+ *
+ * libzypp is not thread safe, the metadata are downloaded by separate worker
+ * processes which do not evaluate any callback. If the parallel refresh fails
+ * for a repository (e.g. a new GPG key needs to be confirmed by the user)
+ * it is refreshed again the usual way with all callbacks.
+ *
+ * @param integer workers max. number of refresh workers, 0 or 1 disables the
+ *   parallel refresh (the default)
+ * @return boolean true on success, false if the value is invalid
+ **/
+YCPValue PkgFunctions::SetParallelRefresh(const YCPInteger &workers)
+{
+    if (workers.isNull() || workers->value() < 0)
+    {
+	y2error("Invalid number of refresh workers: %s", workers.isNull() ? "nil" : workers->toString().c_str());
+	return YCPBoolean(false);
+    }
+
+    parallel_refresh = workers->value();
+    y2milestone("Parallel refresh workers: %d", parallel_refresh);
+
+    return YCPBoolean(true);
+}
+
+int PkgFunctions::RefreshWorker(const zypp::RepoInfo &repo, zypp::RepoManager *repomanager)
+{
+    int ret = REFRESH_WORKER_FAILED;
+
+    try
+    {
+	zypp::RepoManager::RefreshCheckStatus ref_stat = repomanager->checkIfToRefreshMetadata(repo, repo.url());
+
+	if (ref_stat != zypp::RepoManager::REFRESH_NEEDED)
+	{
+	    y2milestone("Skipping repository '%s' - refresh is not needed", repo.alias().c_str());
+	    ret = REFRESH_WORKER_NOT_NEEDED;
+	}
+	else
+	{
+	    y2milestone("Autorefreshing source: %s", repo.alias().c_str());
+	    repomanager->refreshMetadata(repo, zypp::RepoManager::RefreshForced);
+	    ret = REFRESH_WORKER_OK;
+	}
+    }
+    catch (const zypp::Exception& excpt)
+    {
+	y2error("Parallel refresh of '%s' failed: %s", repo.alias().c_str(), excpt.asString().c_str());
+    }
+
+    return ret;
+}
+
+void PkgFunctions::ParallelAutorefresh(const RepoCont &candidates, zypp::RepoManager *repomanager,
+    zypp::ProgressData &prog_total, RepoCont &refreshed, RepoCont &cache_built, bool &success, int workers)
+{
+    y2milestone("Refreshing %zd repositories using %d workers", candidates.size(), workers);
+
+    ForkedWorkers procs([this] { _callbackHandler.disconnectReceivers(); });
+    // PID => repository
+    std::map<pid_t, YRepo_Ptr> running;
+    RepoCont::const_iterator next = candidates.begin();
+
+    auto finished = [&](pid_t pid, int status)
+    {
+	YRepo_Ptr repo = running[pid];
+	running.erase(pid);
+
+	if (status < 0 || !WIFEXITED(status) || WEXITSTATUS(status) == REFRESH_WORKER_FAILED)
+	{
+	    y2warning("Parallel refresh of repository '%s' failed, it will be refreshed again",
+		repo->repoInfo().alias().c_str());
+	    return;
+	}
+
+	refreshed.push_back(repo);
+
+	// the cached files might not match the new metadata
+	if (ForkedWorkers::exited(status, REFRESH_WORKER_OK))
+	    download_cache.invalidate(repo->repoInfo().alias());
+
+	// the refresh step is finished
+	prog_total.incr(100);
+	y2debug("Progress status: %lld", prog_total.val());
+
+	// the same condition as in the sequential cache rebuild
+	if (!repo->repoInfo().autorefresh() || autorefresh_skipped)
+	    return;
+
+	// rebuild the cache while the other workers are still downloading
+	cache_built.push_back(repo);
+	zypp::CombinedProgressData rebuild_subprogress(prog_total, 100);
+
+	try
+	{
+	    y2milestone("Rebuilding cache for '%s'...", repo->repoInfo().alias().c_str());
+	    repomanager->buildCache(repo->repoInfo(), zypp::RepoManager::BuildIfNeeded, rebuild_subprogress);
+	}
+	catch (const zypp::Exception& excpt)
+	{
+	    if (autorefresh_skipped)
+	    {
+		y2warning("autorefresh_skipped, ignoring the exception");
+	    }
+	    else
+	    {
+		y2error ("Error in SourceLoad: %s", excpt.asString().c_str());
+		_last_error.setLastError(ExceptionAsString(excpt));
+		success = false;
+	    }
+	}
+    };
+
+    while (next != candidates.end() || procs.running() > 0)
+    {
+	// start new workers up to the limit
+	while (next != candidates.end() && (int)procs.running() < workers && !autorefresh_skipped)
+	{
+	    const zypp::RepoInfo &repo = (*next)->repoInfo();
+	    pid_t pid = procs.start([&] { return RefreshWorker(repo, repomanager); });
+
+	    if (pid < 0)
+	    {
+		// the remaining repositories will be refreshed sequentially
+		y2error("Cannot start a refresh worker: %s", strerror(errno));
+		next = candidates.end();
+		break;
+	    }
+
+	    y2milestone("Refreshing repository '%s' in process %d", repo.alias().c_str(), pid);
+	    running[pid] = *next;
+	    ++next;
+	}
+
+	size_t collected = procs.collect(finished);
+
+	if (autorefresh_skipped)
+	{
+	    y2warning("Skipping autorefresh for the rest of repositories");
+	    procs.killAll();
+	    break;
+	}
+
+	// wait a bit before checking the workers again
+	if (collected == 0 && procs.running() > 0 && !procs.pause([&] { return prog_total.tick(); }))
+	{
+	    y2milestone("Parallel refresh aborted");
+	    autorefresh_skipped = true;
+	}
+    }
+}
+
 YCPValue
 PkgFunctions::SourceLoadImpl(PkgProgress &progress)
 {
@@ -239,12 +414,52 @@ PkgFunctions::SourceLoadImpl(PkgProgress &progress)
     // don't load packages from them
     RepoCont failed_refresh;
 
-    if (repos_to_refresh > 0)
+    // repositories refreshed and cached by the parallel refresh
+    RepoCont refreshed;
+    RepoCont cache_built;
+
+    if (repos_to_refresh > 1 && parallel_refresh > 1)
+    {
+	RepoCont candidates;
+
+	// the same conditions as in the sequential refresh below,
+	// the skipped repositories are handled (and logged) there
+	for (RepoCont::iterator it = repos.begin();
+	   it != repos.end(); ++it)
+	{
+	    if (!(*it)->repoInfo().enabled() || (*it)->isDeleted() || (*it)->isLoaded()
+		|| (*it)->repoInfo().baseUrlsEmpty())
+		continue;
+
+	    if (!(*it)->repoInfo().autorefresh() && !repomanager->metadataStatus((*it)->repoInfo()).empty())
+		continue;
+
+	    if (!network_is_running && remoteRepo((*it)->repoInfo().url()))
+		continue;
+
+	    candidates.push_back(*it);
+	}
+
+	if (candidates.size() > 1)
+	{
+	    // call the init callback
+	    CallRefreshStarted();
+	    refresh_started_called = true;
+
+	    ParallelAutorefresh(candidates, repomanager, prog_total, refreshed, cache_built, success, parallel_refresh);
+	}
+    }
+
+    if (repos_to_refresh > 0 && !autorefresh_skipped)
     {
 	// refresh metadata
 	for (RepoCont::iterator it = repos.begin();
 	   it != repos.end(); ++it)
 	{
+	    // already refreshed in parallel, the progress has been already reported
+	    if (find(refreshed.begin(), refreshed.end(), *it) != refreshed.end())
+		continue;
+
 	    // load resolvables only from enabled repos which are not deleted
 	    if ((*it)->repoInfo().enabled() && !(*it)->isDeleted())
 	    {
@@ -353,6 +568,10 @@ PkgFunctions::SourceLoadImpl(PkgProgress &progress)
     for (RepoCont::iterator it = repos.begin();
        it != repos.end(); ++it)
     {
+	// already built after the parallel refresh, the progress has been already reported
+	if (find(cache_built.begin(), cache_built.end(), *it) != cache_built.end())
+	    continue;
+
 	// load resolvables only from enabled repos which are not deleted
 	if ((*it)->repoInfo().enabled() && !(*it)->isDeleted())
 	{
@@ -74,37 +74,151 @@ YRepo_Ptr PkgFunctions::logFindRepository(RepoId id)
     return YRepo_Ptr();
 }
 
-PkgFunctions::RepoId PkgFunctions::logFindAlias(const std::string &alias) const
+PkgFunctions::RepoId PkgFunctions::AddRepo(const YRepo_Ptr &repo)
 {
-    RepoId index = 0LL;
+    std::lock_guard<std::recursive_mutex> lock(repo_index_mutex);
+
+    repos.push_back(repo);
+
+    RepoId id = repos.size() - 1;
+
+    // keep the first not deleted repository with the same alias (as the previous linear search did)
+    std::pair<std::unordered_map<std::string, RepoId>::iterator, bool> res = alias_index.emplace(repo->repoInfo().alias(), id);
+    if (!res.second && repos[res.first->second]->isDeleted())
+	res.first->second = id;
+
+    return id;
+}
+
+void PkgFunctions::MarkRepoDeleted(RepoId id)
+{
+    if (id < 0 || id >= (long long)repos.size() || !repos[id])
+	return;
+
+    std::lock_guard<std::recursive_mutex> lock(repo_index_mutex);
+
+    YRepo_Ptr repo = repos[id];
+    repo->setDeleted();
+
+    // do not use the files downloaded from the removed repository
+    download_cache.invalidate(repo->repoInfo().alias());
+
+    std::unordered_map<std::string, RepoId>::iterator it = alias_index.find(repo->repoInfo().alias());
+    if (it != alias_index.end() && it->second == id)
+	alias_index.erase(it);
+}
 
+void PkgFunctions::ClearRepos()
+{
+    std::lock_guard<std::recursive_mutex> lock(repo_index_mutex);
+
+    repos.clear();
+    alias_index.clear();
+    sat_repo_index.clear();
+}
+
+void PkgFunctions::RebuildAliasIndex() const
+{
+    alias_index.clear();
+
+    RepoId index = 0LL;
     for(RepoCont::const_iterator it = repos.begin(); it != repos.end() ; ++it, ++index)
     {
-	if (!(*it)->isDeleted() && (*it)->repoInfo().alias() == alias)
-	    return index;
+	// the first not deleted repository wins
+	if (!(*it)->isDeleted())
+	    alias_index.emplace((*it)->repoInfo().alias(), index);
     }
+}
+
+PkgFunctions::RepoId PkgFunctions::logFindAlias(const std::string &alias) const
+{
+    std::lock_guard<std::recursive_mutex> lock(repo_index_mutex);
+
+    std::unordered_map<std::string, RepoId>::const_iterator it = alias_index.find(alias);
 
-    return -1LL;
+    if (it == alias_index.end())
+	return -1LL;
+
+    RepoId index = it->second;
+
+    if (index < (long long)repos.size() && !repos[index]->isDeleted()
+	&& repos[index]->repoInfo().alias() == alias)
+	return index;
+
+    // the index is out of sync (a repository has been changed directly), rebuild it
+    y2warning("Alias index is out of sync, rebuilding it");
+    RebuildAliasIndex();
+
+    it = alias_index.find(alias);
+    return (it == alias_index.end()) ? -1LL : it->second;
 }
 
-bool PkgFunctions::aliasExists(const std::string &alias, const std::list<zypp::RepoInfo> &reps) const
+PkgFunctions::RepoId PkgFunctions::logFindRepo(const zypp::Repository &repo) const
 {
-    // search in loaded repositories
-    for(RepoCont::const_iterator it = repos.begin(); it != repos.end() ; ++it)
+    // the installed packages do not belong to any Yast repository
+    if (repo == zypp::Repository::noRepository || repo.isSystemRepo())
+	return -1LL;
+
+    std::string alias(repo.alias());
+
+    std::lock_guard<std::recursive_mutex> lock(repo_index_mutex);
+
+    std::unordered_map<zypp::sat::detail::RepoIdType, RepoId>::const_iterator it = sat_repo_index.find(repo.id());
+    if (it != sat_repo_index.end())
     {
-	if (!(*it)->isDeleted() && (*it)->repoInfo().alias() == alias)
-	    return true;
+	RepoId index = it->second;
+
+	// the sat repository might have been released and the pointer reused
+	// for a different repository, check the alias to be sure
+	if (index < (long long)repos.size() && !repos[index]->isDeleted()
+	    && repos[index]->repoInfo().alias() == alias)
+	    return index;
     }
 
-    // search in stored repositories
-    for (std::list<zypp::RepoInfo>::const_iterator it = reps.begin();
-	it != reps.end(); ++it)
+    RepoId index = logFindAlias(alias);
+
+    if (index >= 0)
+	sat_repo_index[repo.id()] = index;
+    else
+	sat_repo_index.erase(repo.id());
+
+    return index;
+}
+
+const PkgFunctions::KnownRepoMap &PkgFunctions::KnownRepos()
+{
+    zypp::RepoManager *repomanager = CreateRepoManager();
+
+    // the cache is still valid
+    if (known_repos_manager == repomanager && known_repos_size == repomanager->repoSize())
+	return known_repos;
+
+    known_repos.clear();
+
+    for_(it, repomanager->repoBegin(), repomanager->repoEnd())
     {
-	if (it->alias() == alias)
-	    return true;
+	known_repos.insert(std::make_pair(it->alias(), *it));
     }
 
-    return false;
+    known_repos_manager = repomanager;
+    known_repos_size = repomanager->repoSize();
+
+    y2debug("Known repositories: %zd", known_repos.size());
+
+    return known_repos;
+}
+
+void PkgFunctions::InvalidateKnownRepos()
+{
+    known_repos.clear();
+    known_repos_manager = NULL;
+    known_repos_size = 0;
+}
+
+bool PkgFunctions::aliasExists(const std::string &alias)
+{
+    // search in loaded repositories, then in stored repositories
+    return logFindAlias(alias) >= 0 || KnownRepos().count(alias) > 0;
 }
 
 // convert libzypp type to yast strings ("YaST", "YUM" or "Plaindir")
@@ -138,10 +252,7 @@ std::string PkgFunctions::UniqueAlias(const std::string &alias)
 
     unsigned int id = 0;
 
-    // search in stored repositories
-    std::list<zypp::RepoInfo> reps = CreateRepoManager()->knownRepositories();
-
-    while(aliasExists(ret, reps))
+    while(aliasExists(ret))
     {
 	y2milestone("Alias %s already found: %lld", ret.c_str(), logFindAlias(ret));
 
@@ -34,6 +34,10 @@
 
 #include <HelpTexts.h>
 
+#include <ycp/YCPBoolean.h>
+#include <ycp/YCPInteger.h>
+#include <ycp/YCPVoid.h>
+
 /*
   Textdomain "pkg-bindings"
 */
@@ -52,7 +56,7 @@ PkgFunctions::SourceReleaseAll ()
     bool ret = true;
 
     y2milestone("Removing all tmp directories");
-    tmp_dirs.clear();
+    download_cache.release();
 
     for (RepoCont::iterator it = repos.begin();
 	it != repos.end(); ++it)
@@ -75,23 +79,83 @@ PkgFunctions::SourceReleaseAll ()
  * @builtin SourceSaveAll
  *
  * @short Save all InstSrces.
+ * @description
+ * Only the changed, added and removed repositories are written,
+ * the unchanged repository files are kept.
  * @return boolean
  **/
 YCPValue
 PkgFunctions::SourceSaveAll ()
+{
+    int written = 0;
+    return YCPBoolean(SourceSaveAllImpl(written));
+}
+
+/**
+ * @builtin SourceSaveAllCount
+ *
+ * @short Save all InstSrces, return the number of the written repositories.
+ * @description
+ * The same as Pkg::SourceSaveAll(), additionally returns the number of the
+ * added, modified or removed repositories (0 if nothing has been changed).
+ * @return integer number of written repositories or nil on error
+ **/
+YCPValue
+PkgFunctions::SourceSaveAllCount ()
+{
+    int written = 0;
+
+    if (!SourceSaveAllImpl(written))
+	return YCPVoid();
+
+    return YCPInteger(written);
+}
+
+bool PkgFunctions::SourceSaveAllImpl(int &written)
 {
     y2milestone("Saving the source setup...");
     bool ret = true;
+    written = 0;
 
     // nothing to save, return success
     if (repos.empty() && service_manager.empty())
     {
 	y2debug("No repository or service defined, saving skipped");
-	return YCPBoolean(ret);
+	return ret;
     }
 
     zypp::RepoManager* repomanager = CreateRepoManager();
 
+    // the repositories which need to be written, a repository is saved also when
+    // it is not known by the repo manager (e.g. the target has been changed)
+    RepoCont removed_repos;
+    RepoCont saved_repos;
+
+    {
+	const KnownRepoMap &known = KnownRepos();
+
+	for (RepoCont::iterator it = repos.begin();
+	    it != repos.end(); ++it)
+	{
+	    if ((*it)->isDeleted())
+	    {
+		// removed since the last save
+		if ((*it)->isDirty())
+		    removed_repos.push_back(*it);
+	    }
+	    else if ((*it)->isDirty() || known.find((*it)->repoInfo().alias()) == known.end())
+	    {
+		saved_repos.push_back(*it);
+	    }
+	}
+    }
+
+    y2milestone("Repositories: %zd, removed: %zd, changed: %zd", repos.size(), removed_repos.size(), saved_repos.size());
+
+    // the repository files are going to be written (even partially on error),
+    // the known repositories are read again when needed
+    InvalidateKnownRepos();
+
     // save the services
     try
     {
@@ -104,30 +168,21 @@ PkgFunctions::SourceSaveAll ()
 	ret = false;
     }
 
-    // count removed repos
-    int removed_repos = 0;
-    for (RepoCont::iterator it = repos.begin();
-	it != repos.end(); ++it)
+    if (removed_repos.empty() && saved_repos.empty())
     {
-	// the repo has been removed
-	if ((*it)->isDeleted())
-	{
-	    removed_repos++;
-	}
+	y2milestone("No repository changed, saving skipped");
+	return ret;
     }
 
-    y2debug("Found %d removed repositories", removed_repos);
-
     // number of steps:
     //   for removed repository: 3 (remove metadata, remove from cache, remove .repo file)
     //   for other repositories: 1 (just save/update .repo file)
-    //   (so there are 2 extra steps for removed repos)
-    int save_steps = 2*removed_repos + repos.size();
+    int save_steps = 3*removed_repos.size() + saved_repos.size();
 
     PkgProgress pkgprogress(_callbackHandler);
     std::list<std::string> stages;
 
-    if (removed_repos > 0)
+    if (!removed_repos.empty())
     {
 	stages.push_back(_("Remove Repositories"));
     }
@@ -145,96 +200,97 @@ PkgFunctions::SourceSaveAll ()
     pkgprogress.Start(_("Saving Repositories..."), stages, _(HelpTexts::save_help));
 
     // remove deleted repos (the old configurations) at first
-    for (RepoCont::iterator it = repos.begin();
-	it != repos.end(); ++it)
+    for (RepoCont::iterator it = removed_repos.begin();
+	it != removed_repos.end(); ++it)
     {
-	// the repo has been removed
-	if ((*it)->isDeleted())
-	{
-	    std::string repo_alias = (*it)->repoInfo().alias();
+	std::string repo_alias = (*it)->repoInfo().alias();
 
-	    try
+	try
+	{
+	    // remove the metadata
+	    zypp::RepoStatus raw_metadata_status = repomanager->metadataStatus((*it)->repoInfo());
+	    if (!raw_metadata_status.empty())
 	    {
-		// remove the metadata
-		zypp::RepoStatus raw_metadata_status = repomanager->metadataStatus((*it)->repoInfo());
-		if (!raw_metadata_status.empty())
-		{
-		    y2milestone("Removing metadata for source '%s'...", repo_alias.c_str());
-		    repomanager->cleanMetadata((*it)->repoInfo());
-		}
-		prog_total.incr();
-
-		// remove the cache
-		if (repomanager->isCached((*it)->repoInfo()))
-		{
-		    y2milestone("Removing cache for '%s'...", repo_alias.c_str());
-		    repomanager->cleanCache((*it)->repoInfo());
-		}
-		prog_total.incr();
-
-		// does the repository exist?
-		repomanager->getRepositoryInfo(repo_alias);
-		y2milestone("Removing repository '%s'", repo_alias.c_str());
-		repomanager->removeRepository((*it)->repoInfo());
-		prog_total.incr();
+		y2milestone("Removing metadata for source '%s'...", repo_alias.c_str());
+		repomanager->cleanMetadata((*it)->repoInfo());
 	    }
-	    catch (const zypp::repo::RepoNotFoundException &ex)
+	    prog_total.incr();
+
+	    // remove the cache
+	    if (repomanager->isCached((*it)->repoInfo()))
 	    {
-		// repository not found -- not critical, continue
-		y2warning("No such repository: %s", repo_alias.c_str());
+		y2milestone("Removing cache for '%s'...", repo_alias.c_str());
+		repomanager->cleanCache((*it)->repoInfo());
 	    }
-	    catch (const zypp::Exception & excpt)
+	    prog_total.incr();
+
+	    // a repository which has not been saved yet has no .repo file
+	    if (!((*it)->dirty() & YRepo::NEW))
 	    {
-		y2error("Pkg::SourceSaveAll has failed: %s", excpt.msg().c_str() );
-		_last_error.setLastError(ExceptionAsString(excpt));
-		return YCPBoolean(false);
+		y2milestone("Removing repository '%s'", repo_alias.c_str());
+		repomanager->removeRepository((*it)->repoInfo());
+		++written;
 	    }
+	    prog_total.incr();
+
+	    (*it)->resetDirty();
+	}
+	catch (const zypp::repo::RepoNotFoundException &ex)
+	{
+	    // repository not found -- not critical, continue
+	    y2warning("No such repository: %s", repo_alias.c_str());
+	    (*it)->resetDirty();
+	}
+	catch (const zypp::Exception & excpt)
+	{
+	    y2error("Pkg::SourceSaveAll has failed: %s", excpt.msg().c_str() );
+	    _last_error.setLastError(ExceptionAsString(excpt));
+	    return false;
 	}
     }
 
-    if (removed_repos > 0)
+    if (!removed_repos.empty())
     {
 	pkgprogress.NextStage();
     }
 
-    // save all repos (the current configuration)
-    for (RepoCont::iterator it = repos.begin();
-	it != repos.end(); ++it)
+    // save the changed repos (the current configuration)
+    for (RepoCont::iterator it = saved_repos.begin();
+	it != saved_repos.end(); ++it)
     {
-	if (!(*it)->isDeleted())
-	{
-	    std::string current_alias = (*it)->repoInfo().alias();
+	std::string current_alias = (*it)->repoInfo().alias();
 
+	try
+	{
 	    try
 	    {
-		try
-		{
-		    // if the repository already exists then just modify it
-		    repomanager->getRepositoryInfo(current_alias);
-		    y2milestone("Modifying repository '%s'", current_alias.c_str());
-		    repomanager->modifyRepository(current_alias, (*it)->repoInfo());
-		}
-		catch (const zypp::repo::RepoNotFoundException &ex)
-		{
-		    // the repository was not found, add it
-		    y2milestone("Adding repository '%s'", current_alias.c_str());
-		    repomanager->addRepository((*it)->repoInfo());
-		}
+		// if the repository already exists then just modify it
+		repomanager->getRepositoryInfo(current_alias);
+		y2milestone("Modifying repository '%s' (changes: 0x%x)", current_alias.c_str(), (*it)->dirty());
+		repomanager->modifyRepository(current_alias, (*it)->repoInfo());
 	    }
-	    catch (zypp::Exception & excpt)
+	    catch (const zypp::repo::RepoNotFoundException &ex)
 	    {
-		y2error("Pkg::SourceSaveAll has failed: %s", excpt.msg().c_str() );
-		_last_error.setLastError(ExceptionAsString(excpt));
-		return YCPBoolean(false);
+		// the repository was not found, add it
+		y2milestone("Adding repository '%s'", current_alias.c_str());
+		repomanager->addRepository((*it)->repoInfo());
 	    }
-
-	    prog_total.incr();
 	}
+	catch (zypp::Exception & excpt)
+	{
+	    y2error("Pkg::SourceSaveAll has failed: %s", excpt.msg().c_str() );
+	    _last_error.setLastError(ExceptionAsString(excpt));
+	    return false;
+	}
+
+	(*it)->resetDirty();
+	++written;
+	prog_total.incr();
     }
 
-    y2milestone("All sources have been saved");
+    y2milestone("All sources have been saved, written repositories: %d", written);
 
-    return YCPBoolean(ret);
+    return ret;
 }
 
 /**
@@ -273,7 +329,8 @@ PkgFunctions::SourceFinishAll ()
 	}
 
 	// release all repositories
-	repos.clear();
+	ClearRepos();
+	CloseStaleResolvableCursors();
 
 	// release all services
 	service_manager.Reset();
@@ -63,7 +63,7 @@ PkgFunctions::SourceSetEnabled (const YCPInteger& id, const YCPBoolean& e)
 
     try
     {
-	repo->repoInfo().setEnabled(enable);
+	repo->setEnabled(enable);
 
 	// add/remove resolvables
 	if (enable)
@@ -118,7 +118,7 @@ PkgFunctions::SourceSetPriority(const YCPInteger& id, const YCPInteger& priority
     YRepo_Ptr repo = logFindRepository(id->value());
     if (!repo) return YCPBoolean(false);
 
-    repo->repoInfo().setPriority(priority->value());
+    repo->setPriority(priority->value());
 
     // apply the priority also on the loaded packages in the pool (bsc#498266),
     zypp::Repository r(zypp::sat::Pool::instance().reposFind(repo->repoInfo().alias()));
@@ -152,7 +152,7 @@ PkgFunctions::SourceSetAutorefresh (const YCPInteger& id, const YCPBoolean& e)
     if (!repo)
 	return YCPBoolean(false);
 
-    repo->repoInfo().setAutorefresh(e->value());
+    repo->setAutorefresh(e->value());
 
     return YCPBoolean( true );
 }
@@ -215,14 +215,14 @@ PkgFunctions::SourceEditSet (const YCPList& states)
 	}
 
         y2debug("set enabled: %d", enable);
-	repo->repoInfo().setEnabled(enable);
+	repo->setEnabled(enable);
     }
 
     if( !descr->value(YCPString("autorefresh")).isNull() && descr->value(YCPString("autorefresh"))->isBoolean ())
     {
         bool autorefresh = descr->value(YCPString("autorefresh"))->asBoolean()->value();
         y2debug("set autorefresh: %d", autorefresh);
-	repo->repoInfo().setAutorefresh( autorefresh );
+	repo->setAutorefresh( autorefresh );
     }
 
     if( !descr->value(YCPString("raw_name")).isNull() && descr->value(YCPString("raw_name"))->isString())
@@ -230,14 +230,14 @@ PkgFunctions::SourceEditSet (const YCPList& states)
 	// rename the source
 	string raw_name = descr->value(YCPString("raw_name"))->asString()->value();
 	y2debug("set name: %s", raw_name.c_str());
-	repo->repoInfo().setName(raw_name);
+	repo->setName(raw_name);
     }
     else if( !descr->value(YCPString("name")).isNull() && descr->value(YCPString("name"))->isString())
     {
 	// rename the source
 	string name = descr->value(YCPString("name"))->asString()->value();
 	y2debug("set name: %s", name.c_str());
-	repo->repoInfo().setName(name);
+	repo->setName(name);
     }
 
     if( !descr->value(YCPString("priority")).isNull() && descr->value(YCPString("priority"))->isInteger())
@@ -246,21 +246,21 @@ PkgFunctions::SourceEditSet (const YCPList& states)
 
 	// set the priority
 	y2debug("set priority: %d", priority);
-	repo->repoInfo().setPriority(priority);
+	repo->setPriority(priority);
     }
 
     if(!descr->value(YCPString("keeppackages")).isNull() && descr->value(YCPString("keeppackages"))->isBoolean())
     {
         bool keeppackages = descr->value(YCPString("keeppackages"))->asBoolean()->value();
         y2debug("set keeppackages: %d", keeppackages);
-	repo->repoInfo().setKeepPackages( keeppackages );
+	repo->setKeepPackages( keeppackages );
     }
 
     if( !descr->value(YCPString("service")).isNull() && descr->value(YCPString("service"))->isString())
     {
         string service = descr->value(YCPString("service"))->asString()->value();
         y2debug("set service: %s", service.c_str());
-        repo->repoInfo().setService(service);
+        repo->setService(service);
     }
   }
 
@@ -300,6 +300,11 @@ PkgFunctions::SourceChangeUrl (const YCPInteger& id, const YCPString& u)
         }
         else
             repo->repoInfo().setBaseUrl(zypp::Url(u->value()));
+
+        repo->setDirty(YRepo::URL);
+
+        // the cached files have been downloaded from the old URL
+        download_cache.invalidate(repo->repoInfo().alias());
     }
     catch (const zypp::Exception & excpt)
     {
@@ -348,7 +353,7 @@ PkgFunctions::SourceRaisePriority (const YCPInteger& id)
 	prio--;
 
 	// set the new priority
-	repo->repoInfo().setPriority(prio);
+	repo->setPriority(prio);
     }
 
     return YCPBoolean(true);
@@ -384,7 +389,7 @@ PkgFunctions::SourceLowerPriority (const YCPInteger& id)
 	prio++;
 
 	// set the new priority
-	repo->repoInfo().setPriority(prio);
+	repo->setPriority(prio);
     }
 
     return YCPBoolean(true);
@@ -418,7 +423,7 @@ PkgFunctions::SourceDelete (const YCPInteger& id)
 	RemoveResolvablesFrom(repo);
 
 	// update 'repos'
-	repo->setDeleted();
+	MarkRepoDeleted(id->value());
 
 	// removing the base product repository?
 	if (base_product && base_product->repo_alias == repo_alias)
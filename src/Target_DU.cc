@@ -126,6 +126,7 @@ void PkgFunctions::SetCurrentDU()
 
     // set the mount points
     zypp_ptr()->setPartitions(system);
+    du_index.reset();
 }
 
 YCPMap PkgFunctions::MPS2YCPMap(const zypp::DiskUsageCounter::MountPointSet &mps)
@@ -303,6 +304,7 @@ PkgFunctions::TargetInitDU (const YCPList& dirlist)
     try
     {
 	zypp_ptr()->setPartitions(mount_points);
+	du_index.reset();
     }
     catch(const zypp::Exception &excpt)
     {
@@ -342,9 +344,9 @@ PkgFunctions::TargetGetDU ()
 
     try
     {
-	zypp::DiskUsageCounter::MountPointSet mps = zypp_ptr()->diskUsage();
+	zypp::DiskUsageCounter::MountPointSet partitions = zypp_ptr()->getPartitions();
 
-	if (mps.empty())
+	if (partitions.empty())
 	{
 	    // mount points have not been defined
 	    y2warning("Pkg::TargetDUInit() has not been called, using data from system...");
@@ -353,10 +355,11 @@ PkgFunctions::TargetGetDU ()
 	    SetCurrentDU();
 
 	    // try it again
-	    mps = zypp_ptr()->diskUsage();
+	    partitions = zypp_ptr()->getPartitions();
 	}
 
-	dirmap = MPS2YCPMap(mps);
+	// only the selection changes since the last call are evaluated
+	dirmap = MPS2YCPMap(du_index.selection(partitions));
     }
     catch(const zypp::Exception &excpt)
     {
@@ -84,6 +84,8 @@ PkgFunctions::TargetInitInternal(const YCPString& root, bool rebuild_rpmdb)
 	pkgprogress.NextStage();
         zypp_ptr()->target()->load();
 	_target_loaded = true;
+	product_cache.clear();
+	CloseStaleResolvableCursors();
     }
     catch (zypp::Exception & excpt)
     {
@@ -169,6 +171,8 @@ PkgFunctions::TargetInitializeOptions (const YCPString& root, const YCPMap& opti
 
         zypp_ptr()->initializeTarget(r, rebuild_db);
         SetTarget(r, options);
+        product_cache.clear();
+        CloseStaleResolvableCursors();
     }
     catch (zypp::Exception & excpt)
     {
@@ -206,6 +210,8 @@ PkgFunctions::TargetLoad ()
     {
         zypp_ptr()->target()->load();
 	_target_loaded = true;
+	product_cache.clear();
+	CloseStaleResolvableCursors();
     }
     catch (zypp::Exception & excpt)
     {
@@ -232,6 +238,8 @@ PkgFunctions::TargetFinish ()
     try
     {
 	zypp_ptr()->finishTarget();
+	product_cache.clear();
+	CloseStaleResolvableCursors();
 
 	zypp::Pathname lock_file(_target_root + zypp::ZConfig::instance().locksFile());
 	zypp::Locks::instance().save(lock_file);
@@ -22,6 +22,7 @@
 
 
 #include "Y2PkgFunction.h"
+#include "PkgStats.h"
 
 #include <ycp/YCPBoolean.h>
 #include <ycp/YCPValue.h>
@@ -129,6 +130,13 @@
     {
 	ycpmilestone ("Pkg Builtin called: %s", name().c_str() );
 
+	// record the call statistics when leaving the function
+	PkgStats::Call stats (m_name);
+
+	// an asynchronous commit is running
+	if (!m_instance->CallAllowed (m_name))
+	    return YCPVoid ();
+
 	try
 	{
 	    switch (m_position) {
@@ -31,8 +31,8 @@
 
 IMPL_PTR_TYPE(YRepo);
 
-YRepo::YRepo(zypp::RepoInfo & repo)
-    : _repo(repo), _deleted(false), _loaded(false)
+YRepo::YRepo(zypp::RepoInfo & repo, bool saved)
+    : _repo(repo), _deleted(false), _loaded(false), _dirty(saved ? CLEAN : NEW)
 {}
 
 YRepo::~YRepo()
@@ -59,5 +59,59 @@ zypp::MediaSetAccess_Ptr & YRepo::mediaAccess()
     return _maccess;
 }
 
+void YRepo::setEnabled(bool enabled)
+{
+    if (_repo.enabled() == enabled)
+	return;
+
+    _repo.setEnabled(enabled);
+    _dirty |= ENABLED;
+}
+
+void YRepo::setAutorefresh(bool autorefresh)
+{
+    if (_repo.autorefresh() == autorefresh)
+	return;
+
+    _repo.setAutorefresh(autorefresh);
+    _dirty |= AUTOREFRESH;
+}
+
+void YRepo::setName(const std::string &name)
+{
+    if (_repo.rawName() == name)
+	return;
+
+    _repo.setName(name);
+    _dirty |= NAME;
+}
+
+void YRepo::setPriority(unsigned priority)
+{
+    if (_repo.priority() == priority)
+	return;
+
+    _repo.setPriority(priority);
+    _dirty |= PRIORITY;
+}
+
+void YRepo::setKeepPackages(bool keep)
+{
+    if (_repo.keepPackages() == keep)
+	return;
+
+    _repo.setKeepPackages(keep);
+    _dirty |= KEEPPACKAGES;
+}
+
+void YRepo::setService(const std::string &service)
+{
+    if (_repo.service() == service)
+	return;
+
+    _repo.setService(service);
+    _dirty |= SERVICE;
+}
+
 const YRepo YRepo::NOREPO;
 
@@ -35,24 +35,58 @@
 DEFINE_PTR_TYPE(YRepo);
 class YRepo : public zypp::base::ReferenceCounted
 {
+public:
+    // the changes not saved yet, Pkg::SourceSaveAll() writes only
+    // the changed repositories
+    enum DirtyFlags
+    {
+	CLEAN		= 0,
+	NEW		= 1 << 0,
+	DELETED		= 1 << 1,
+	ENABLED		= 1 << 2,
+	AUTOREFRESH	= 1 << 3,
+	NAME		= 1 << 4,
+	PRIORITY	= 1 << 5,
+	KEEPPACKAGES	= 1 << 6,
+	SERVICE		= 1 << 7,
+	URL		= 1 << 8
+    };
+
 private:
     zypp::RepoInfo _repo;
     zypp::MediaSetAccess_Ptr _maccess;
     bool _deleted;
     bool _loaded;
+    unsigned _dirty;
 
     YRepo() {}
 
 public:
-    YRepo(zypp::RepoInfo & repo);
+    // saved: the repository has been read from the repository files
+    YRepo(zypp::RepoInfo & repo, bool saved = false);
     ~YRepo();
 
     const zypp::RepoInfo & repoInfo() const { return _repo; }
+    // use the setters below or setDirty() when changing the repository
     zypp::RepoInfo & repoInfo() { return _repo; }
     zypp::MediaSetAccess_Ptr & mediaAccess();
 
     bool isDeleted() {return _deleted;}
-    void setDeleted() {_deleted = true;}
+    void setDeleted() {_deleted = true; _dirty |= DELETED;}
+
+    unsigned dirty() const {return _dirty;}
+    bool isDirty() const {return _dirty != CLEAN;}
+    void setDirty(unsigned flags) {_dirty |= flags;}
+    // the repository has been saved
+    void resetDirty() {_dirty = CLEAN;}
+
+    // change the repository, the flag is set only if the value differs
+    void setEnabled(bool enabled);
+    void setAutorefresh(bool autorefresh);
+    void setName(const std::string &name);
+    void setPriority(unsigned priority);
+    void setKeepPackages(bool keep);
+    void setService(const std::string &service);
 
     bool isLoaded() {return _loaded;}
     void setLoaded() {_loaded = true;}